@@ -7,13 +7,29 @@
 
 using json = nlohmann::json;
 
-void AutoPallete::init() {
+void AutoPallete::init(PalEdit& Session) {
 
 	std::cout << "Test";
+	for (auto& current_char : Session.Character_Vector) {
+		apply(current_char);
+	}
+	Session.UpdateAllCharacters();
+}
+
+void AutoPallete::init(PalEdit& Session, const std::vector<int>& IDs) {
+	for (int ID : IDs) {
+		int VectorID = Session.FindVectorIndexByID(ID);
+		if (VectorID != -1) {
+			apply(Session.Character_Vector[VectorID]);
+		}
+	}
+	Session.UpdateCharacters(IDs);
+}
+
+void AutoPallete::apply(Character& current_char) {
 	for (auto& Auto_Pal : Auto_Pals) {
 		if (Auto_Pal.PalPath == "") continue;
-		for (auto& current_char : PalEdit::Character_Vector) {
-			if (current_char.Char_Name == Auto_Pal.CharName and current_char.Current_Pallete_Num == Auto_Pal.PalNum) {
+		if (current_char.Char_Name == Auto_Pal.CharName and current_char.Current_Pallete_Num == Auto_Pal.PalNum) {
 
                 std::ifstream file(Auto_Pal.PalPath, std::ios::binary);
 				if (!file.is_open()) {
@@ -42,10 +58,8 @@ void AutoPallete::init() {
                 file.read(reinterpret_cast<char*>(&current_char.LineColor), sizeof(current_char.LineColor));
                 file.read(reinterpret_cast<char*>(&current_char.SuperShadowColor1), sizeof(current_char.SuperShadowColor1));
                 file.read(reinterpret_cast<char*>(&current_char.SuperShadowColor2), sizeof(current_char.SuperShadowColor2));
-			}
 		}
 	}
-	PalEdit::UpdateAllCharacters();
 }
 
 void AutoPallete::load() {
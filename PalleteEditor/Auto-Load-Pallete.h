@@ -2,6 +2,9 @@
 #include <vector>
 #include <string>
 
+class Character;
+class PalEdit;
+
 struct Auto_Pal
 {
 	std::string CharName;
@@ -11,10 +14,15 @@ struct Auto_Pal
 
 class AutoPallete {
 public:
-	static void init();
+	// Every character of the game Session is attached to
+	static void init(PalEdit& Session);
+	// Only the characters of these slots, for a roster that changed in part
+	static void init(PalEdit& Session, const std::vector<int>& IDs);
 	static void save();
 	static void load();
 	static inline std::vector<Auto_Pal> Auto_Pals;
 
+private:
+	static void apply(Character& current_char);
 };
 
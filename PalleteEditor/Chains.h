@@ -0,0 +1,138 @@
+#pragma once
+#include "Memory.h"
+#include "Data/TableReader.h"
+
+// Named pointer chains into Skullgirls memory, built from the loaded AddressTable.
+// All of them start at the module base. Slot is the character slot (0..5).
+namespace Chains {
+	inline Memory::Chain<2> GameStatus() {
+		return Memory::MakeChain(
+			AddressTable::Base_Adress(),
+			AddressTable::Offset_GameStatus());
+	}
+
+	// The six character pointers, one per slot, sit next to each other here
+	inline Memory::Chain<2> SlotTable() {
+		return Memory::MakeChain(
+			AddressTable::Base_Adress(),
+			AddressTable::Offset_Character());
+	}
+
+	inline Memory::Chain<3> CharacterName(int Slot) {
+		return Memory::MakeChain(
+			AddressTable::Base_Adress(),
+			AddressTable::Offset_Character() + Slot * 4,
+			AddressTable::Offset_Name());
+	}
+
+	inline Memory::Chain<3> CurrentPalette(int Slot) {
+		return Memory::MakeChain(
+			AddressTable::Base_Adress(),
+			AddressTable::Offset_Character() + Slot * 4,
+			AddressTable::Offset_CurrentPalette());
+	}
+
+	inline Memory::Chain<4> PaletteTotal(int Slot) {
+		return Memory::MakeChain(
+			AddressTable::Base_Adress(),
+			AddressTable::Offset_Character() + Slot * 4,
+			AddressTable::Offset_PaletteData(),
+			AddressTable::Offset_PaletteTotalOffset());
+	}
+
+	inline Memory::Chain<4> NumberOfColors(int Slot) {
+		return Memory::MakeChain(
+			AddressTable::Base_Adress(),
+			AddressTable::Offset_Character() + Slot * 4,
+			AddressTable::Offset_PaletteData(),
+			AddressTable::Offset_NumberOfColor());
+	}
+
+	// Character palette colors, starting at Color_ID
+	inline Memory::Chain<6> PaletteColors(int Slot, int Pallete_Num, int Color_ID = 0) {
+		return Memory::MakeChain(
+			AddressTable::Base_Adress(),
+			AddressTable::Offset_Character() + Slot * 4,
+			AddressTable::Offset_PaletteData(),
+			AddressTable::Offset_ColorCodeOffset(),
+			4 * Pallete_Num,
+			4 * Color_ID);
+	}
+
+	inline Memory::Chain<5> LineColor(int Slot, int Pallete_Num) {
+		return Memory::MakeChain(
+			AddressTable::Base_Adress(),
+			AddressTable::Offset_Character() + Slot * 4,
+			AddressTable::Offset_PaletteData(),
+			AddressTable::NEW_Offset_LineColor(),
+			4 * Pallete_Num);
+	}
+
+	// Super shadow colors (Index 0 and 1 are adjacent)
+	inline Memory::Chain<6> SuperShadow(int Slot, int Pallete_Num, int Index = 0) {
+		return Memory::MakeChain(
+			AddressTable::Base_Adress(),
+			AddressTable::Offset_Character() + Slot * 4,
+			AddressTable::Offset_PaletteData(),
+			AddressTable::NEW_Offset_SuperShadow(),
+			4 * Pallete_Num,
+			4 * Index);
+	}
+
+	// Hops that lead to the structs behind a slot, every offset is dereferenced.
+	// Used to put pointers read from RemoteViews into the chain cache.
+	inline Memory::Chain<2> CharacterHops(int Slot) {
+		return Memory::MakeChain(
+			AddressTable::Base_Adress(),
+			AddressTable::Offset_Character() + Slot * 4);
+	}
+
+	inline Memory::Chain<3> PaletteDataHops(int Slot) {
+		return Memory::MakeChain(
+			AddressTable::Base_Adress(),
+			AddressTable::Offset_Character() + Slot * 4,
+			AddressTable::Offset_PaletteData());
+	}
+
+	inline Memory::Chain<4> ColorPointersHops(int Slot) {
+		return Memory::MakeChain(
+			AddressTable::Base_Adress(),
+			AddressTable::Offset_Character() + Slot * 4,
+			AddressTable::Offset_PaletteData(),
+			AddressTable::Offset_ColorCodeOffset());
+	}
+
+	inline Memory::Chain<4> SuperShadowPointersHops(int Slot) {
+		return Memory::MakeChain(
+			AddressTable::Base_Adress(),
+			AddressTable::Offset_Character() + Slot * 4,
+			AddressTable::Offset_PaletteData(),
+			AddressTable::NEW_Offset_SuperShadow());
+	}
+
+	inline Memory::Chain<4> LineColorsHops(int Slot) {
+		return Memory::MakeChain(
+			AddressTable::Base_Adress(),
+			AddressTable::Offset_Character() + Slot * 4,
+			AddressTable::Offset_PaletteData(),
+			AddressTable::NEW_Offset_LineColor());
+	}
+
+	// Game code patched by the display toggles
+	inline Memory::Chain<1> DonotdisplayCharCode() {
+		return Memory::MakeChain(AddressTable::NEW_Base_Adress_DonotdisplayCHAR());
+	}
+
+	inline Memory::Chain<1> DonotdisplayShadowsCode() {
+		return Memory::MakeChain(AddressTable::NEW_Base_Adress_DonotdisplaySHADOWS());
+	}
+
+	inline Memory::Chain<1> DisplaySuperShadowCode() {
+		return Memory::MakeChain(AddressTable::NEW_Base_Adress_Display_SuperShadowforever());
+	}
+
+	// Counts the frames the game has drawn. Only if NEW_Base_Adress_FrameCounter is set.
+	inline Memory::Chain<1> FrameCounter() {
+		return Memory::MakeChain(AddressTable::NEW_Base_Adress_FrameCounter());
+	}
+}
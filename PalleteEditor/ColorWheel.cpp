@@ -166,8 +166,7 @@ void ColorWheel::Draw(Character& currentChar, const ColorGroup& group, bool& ope
             // select this row when editing via color editor
             g_selectedIndexMap[wheelKey] = i;
 
-            PalEdit::ChangeColor(i, colorValue);
-            PalEdit::Read_Character();
+            PalEdit::Active().ChangeColor(i, colorValue);
         }
 
         // Numeric inputs for precise adjustment (RGB + Alpha)
@@ -197,9 +196,8 @@ void ColorWheel::Draw(Character& currentChar, const ColorGroup& group, bool& ope
             __int32 newColor = Float4ToARGB(nr, ng, nb, colorFloat[3]);
             // selecting this index because user edited its V value
             g_selectedIndexMap[wheelKey] = i;
-            PalEdit::ChangeColor(i, newColor);
+            PalEdit::Active().ChangeColor(i, newColor);
             currentChar.Character_Colors[i] = newColor;
-            PalEdit::Read_Character();
         }
         ImGui::PopItemWidth();
 
@@ -207,8 +205,7 @@ void ColorWheel::Draw(Character& currentChar, const ColorGroup& group, bool& ope
         if (r != ((colorValue >> 16) & 0xFF) / 255.0f || g != ((colorValue >> 8) & 0xFF) / 255.0f || b != (colorValue & 0xFF) / 255.0f || a != ((colorValue >> 24) & 0xFF) / 255.0f) {
             g_selectedIndexMap[wheelKey] = i;
             colorValue = Float4ToARGB(colorFloat[0], colorFloat[1], colorFloat[2], colorFloat[3]);
-            PalEdit::ChangeColor(i, colorValue);
-            PalEdit::Read_Character();
+            PalEdit::Active().ChangeColor(i, colorValue);
         }
 
         ImGui::PopID();
@@ -342,10 +339,9 @@ void ColorWheel::Draw(Character& currentChar, const ColorGroup& group, bool& ope
             float nr,ng,nb; HSVtoRGB(newHue, newSat, ov, nr, ng, nb);
             __int32 newColor = Float4ToARGB(nr, ng, nb, orig[3]);
             // write immediately
-            PalEdit::ChangeColor(paletteIndex, newColor);
+            PalEdit::Active().ChangeColor(paletteIndex, newColor);
             // update local copy so UI reflects change immediately
             currentChar.Character_Colors[paletteIndex] = newColor;
-            PalEdit::Read_Character();
         }
         // stop dragging on mouse release
         if (!io.MouseDown[0]) {
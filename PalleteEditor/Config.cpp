@@ -51,7 +51,7 @@ void config::init() {
                         g.startIndex = currentIndex;
                         g.count = count;
                         charGroups.push_back(g);
-                        currentIndex += count;
+                        currentIndex += count.get<int>();
                     }
                     GroupColorGroup::characterGroups[charName] = charGroups;
                 }
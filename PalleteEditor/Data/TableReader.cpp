@@ -2,7 +2,7 @@
 #include "TableReader.h"
 #include "tinyfiledialogs.h"
 
-bool AddressTable::LoadFromFile() {
+const char* AddressTable::ChooseFile() {
     const char* filterPatterns[1] = { "*.tbl" };
     const char* filePath = tinyfd_openFileDialog(
         "Load Table",        // 
@@ -15,8 +15,11 @@ bool AddressTable::LoadFromFile() {
     
     if (filePath == NULL) {
         std::cout << "No file choosen" << std::endl;
-        return true;
     }
+    return filePath;
+}
+
+bool AddressTable::LoadFromFile(const char* filePath) {
     std::ifstream file(filePath);
     if (!file.is_open()) {
         std::cerr << "Can't open file" << filePath << std::endl;
@@ -34,12 +37,16 @@ bool AddressTable::LoadFromFile() {
     file.read(reinterpret_cast<char*>(&s_Offset_NumberOfColor), sizeof(int32_t));
     file.read(reinterpret_cast<char*>(&s_Offset_ColorCodeOffset), sizeof(int32_t));
     file.read(reinterpret_cast<char*>(&s_Offset_HueShiftOffset), sizeof(int32_t));
-    if (Base_Adress_For_Delete == 0) {
+    if (s_Base_Adress_For_Delete == 0) {
         file.read(reinterpret_cast<char*>(&s_NEW_Base_Adress_DonotdisplayCHAR), sizeof(int32_t));
         file.read(reinterpret_cast<char*>(&s_NEW_Base_Adress_DonotdisplaySHADOWS), sizeof(int32_t));
         file.read(reinterpret_cast<char*>(&s_NEW_Base_Adress_Display_SuperShadowforever), sizeof(int32_t));
         file.read(reinterpret_cast<char*>(&s_NEW_Offset_LineColor), sizeof(int32_t));
         file.read(reinterpret_cast<char*>(&s_NEW_Offset_SuperShadow), sizeof(int32_t));
+        // Optional, older tables end before it
+        if (!file.read(reinterpret_cast<char*>(&s_NEW_Base_Adress_FrameCounter), sizeof(int32_t))) {
+            s_NEW_Base_Adress_FrameCounter = 0x0;
+        }
     }
     return true;
 }
@@ -62,4 +69,5 @@ void AddressTable::ResetToDefaults() {
     s_NEW_Base_Adress_Display_SuperShadowforever = 0xA479B;
     s_NEW_Offset_LineColor = 0x38;
     s_NEW_Offset_SuperShadow = 0xC;
+    s_NEW_Base_Adress_FrameCounter = 0x0;
 }
\ No newline at end of file
@@ -20,6 +20,8 @@ private:
     inline static int s_NEW_Base_Adress_Display_SuperShadowforever = 0xA479B;
     inline static int s_NEW_Offset_LineColor = 0x38;
     inline static int s_NEW_Offset_SuperShadow = 0xC;
+    // Frame counter of the game, module relative. 0: the table has none.
+    inline static int s_NEW_Base_Adress_FrameCounter = 0x0;
 
 public:
     //  (    )
@@ -39,7 +41,11 @@ public:
     static const int& NEW_Base_Adress_Display_SuperShadowforever() { return s_NEW_Base_Adress_Display_SuperShadowforever; }
     static const int& NEW_Offset_LineColor() { return s_NEW_Offset_LineColor; }
     static const int& NEW_Offset_SuperShadow() { return s_NEW_Offset_SuperShadow; }
+    static const int& NEW_Base_Adress_FrameCounter() { return s_NEW_Base_Adress_FrameCounter; }
 	// 
-    static bool LoadFromFile();
+    // Opens the file dialog, NULL if nothing was chosen
+    static const char* ChooseFile();
+    // Watchers read the table while they tick, load it through PalEdit::LoadTable
+    static bool LoadFromFile(const char* filePath);
     static void ResetToDefaults();
 };
\ No newline at end of file
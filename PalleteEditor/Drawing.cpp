@@ -1,9 +1,11 @@
 #include "Drawing.h"
 #include "PalleteEditor.h"
+#include "Memory.h"
 #include "FileLoad.h"
 #include "Auto-Load-Pallete.h"
 #include "tinyfiledialogs.h"
 #include "ColorWheel.h"
+#include <algorithm>
 
 void Drawing::Active()
 {
@@ -21,7 +23,8 @@ void Drawing::Draw()
 	{
 		static std::unordered_map<std::string, bool> wheelOpenMap;
 
-		PalEdit::Init();
+		PalEdit::Update();
+		PalEdit& Game = PalEdit::Active();
 		ImGui::SetNextWindowSize(vWindowSize, ImGuiCond_Once);
 		ImGui::SetNextWindowBgAlpha(1.0f);
 		ImGui::Begin(lpWindowName, &bDraw, WindowFlags);
@@ -33,31 +36,37 @@ void Drawing::Draw()
 				{
 					if (ImGui::MenuItem("Load Table"))
 					{
-						AddressTable::LoadFromFile();
+						if (const char* Path = AddressTable::ChooseFile()) {
+							PalEdit::LoadTable(Path);
+						}
 					}
 					ImGui::Separator();
 					if (ImGui::MenuItem("Load JSON (Characters parts)"))
 					{
 						GroupColorGroup::LoadFromFile();
 					}
-					if (PalEdit::bGameOpenned and PalEdit::bMatchStarted and (PalEdit::current_character_idx != -1)) {
+					if (Game.bGameOpenned and Game.bMatchStarted and (Game.current_character_idx != -1)) {
 						ImGui::Separator();
 						if (ImGui::MenuItem("Save Pallete"))
 						{
-							PalleteFile::SaveToFile(
-								PalEdit::Character_Vector[PalEdit::FindVectorIndexByID(PalEdit::current_character_idx)]
-							);
+							// The published character, as of the end of the last frame
+							if (auto Ch = Game.Model().Current()->Find(Game.current_character_idx)) {
+								PalleteFile::SaveToFile(*Ch);
+							}
 						}
 						if (ImGui::MenuItem("Load Pallete"))
 						{
-							if (PalleteFile::LoadFromFile(
-								PalEdit::Character_Vector[PalEdit::FindVectorIndexByID(PalEdit::current_character_idx)]
-							)) {
-								PalEdit::ChangeAllColors();
-								PalEdit::ChangeLineColor();
-								PalEdit::ChangeSuperShadow1();
-								PalEdit::ChangeSuperShadow2();
-								PalEdit::Read_Character();
+							// Into a copy, the session takes the new version and writes it next frame
+							if (auto Ch = Game.Model().Current()->Find(Game.current_character_idx)) {
+								Character Loaded = *Ch;
+								if (PalleteFile::LoadFromFile(Loaded)) {
+									Game.Model().Edit(Loaded.ID, [&](Character& Next) {
+										Next.Character_Colors = Loaded.Character_Colors;
+										Next.LineColor = Loaded.LineColor;
+										Next.SuperShadowColor1 = Loaded.SuperShadowColor1;
+										Next.SuperShadowColor2 = Loaded.SuperShadowColor2;
+									});
+								}
 							}
 						}
 					}
@@ -92,32 +101,51 @@ void Drawing::Draw()
 				if (ImGui::BeginTabBar("##TabBar")) {
 				if (ImGui::BeginTabItem("Pallete")) {
 			
-				if (PalEdit::bGameOpenned != true) {
+				// Several games are running, the one picked here is edited
+				std::vector<std::shared_ptr<PalEdit>> Sessions = PalEdit::Sessions();
+				if (Sessions.size() > 1) {
+					std::string Game_Name = "Skullgirls (PID " + std::to_string(Game.ProcessId) + ")";
+					ImGui::Text("Select game:");
+					if (ImGui::BeginCombo("##GameSelect", Game_Name.c_str())) {
+						for (const auto& Session : Sessions) {
+							bool is_selected = (Session->ProcessId == Game.ProcessId);
+							std::string Display_Name = "Skullgirls (PID " + std::to_string(Session->ProcessId) + ")";
+							if (ImGui::Selectable(Display_Name.c_str(), is_selected)) {
+								PalEdit::Select(Session);
+							}
+							if (is_selected) {
+								ImGui::SetItemDefaultFocus();
+							}
+						}
+						ImGui::EndCombo();
+					}
+				}
+				if (Game.bGameOpenned != true) {
 					ImGui::Text("Open the game to use the editor.");
 
 				}
 				else {
-					if (PalEdit::bMatchStarted != true) {
+					if (Game.bMatchStarted != true) {
 						ImGui::Text("Start a match to use the editor.\nIf this message persists, the table may be invalid.");
 					}
 					else {
 						//-  
 						ImGui::Text("Select character:");
 						const char* preview_text = "Select";
-						for (const auto& character : PalEdit::Character_Vector) {
-							if (character.ID == PalEdit::current_character_idx) {
+						for (const auto& character : Game.Character_Vector) {
+							if (character.ID == Game.current_character_idx) {
 								preview_text = character.Char_Name.c_str();
 								break;
 							}
 						}
 
 						if (ImGui::BeginCombo("##CharSelect", preview_text)) {
-							for (int i = 0; i < PalEdit::Character_Vector.size(); i++) {
+							for (int i = 0; i < Game.Character_Vector.size(); i++) {
 								//  ID,     
-								bool is_selected = (PalEdit::current_character_idx == PalEdit::Character_Vector[i].ID);
+								bool is_selected = (Game.current_character_idx == Game.Character_Vector[i].ID);
 
-								std::string Display_Name = PalEdit::Character_Vector[i].Char_Name;
-								if (PalEdit::Character_Vector[i].ID < 3) {
+								std::string Display_Name = Game.Character_Vector[i].Char_Name;
+								if (Game.Character_Vector[i].ID < 3) {
 									Display_Name += " (Player 1)";
 								}
 								else {
@@ -126,8 +154,8 @@ void Drawing::Draw()
 
 								if (ImGui::Selectable(Display_Name.c_str(), is_selected)) {
 									//  ID  
-									PalEdit::current_character_idx = PalEdit::Character_Vector[i].ID;
-									PalEdit::Read_Character();
+									Game.current_character_idx = Game.Character_Vector[i].ID;
+									Game.Read_Character();
 								}
 								if (is_selected) {
 									ImGui::SetItemDefaultFocus();
@@ -135,17 +163,34 @@ void Drawing::Draw()
 							}
 							ImGui::EndCombo();
 						}						
-						if (PalEdit::current_character_idx != -1) {
-							Character& currentChar = PalEdit::Character_Vector[PalEdit::FindVectorIndexByID(PalEdit::current_character_idx)];
+						if (Game.current_character_idx != -1) {
+							Character& currentChar = Game.Character_Vector[Game.FindVectorIndexByID(Game.current_character_idx)];
 							int displayValue = currentChar.Current_Pallete_Num + 1;
 							if (ImGui::SliderInt("PalleteNum##", &displayValue, 1, currentChar.Max_Pallete_Num)) { //  
 								{
 
 									currentChar.Current_Pallete_Num = displayValue - 1;
-									PalEdit::ChangePallete();
-									PalEdit::Read_Character();
+									Game.ChangePallete();
 								};
 							};
+							static int CopyFrom = 1;
+							static int CopyTo = 1;
+							ImGui::PushItemWidth(80);
+							ImGui::InputInt("From##CopyPallete", &CopyFrom);
+							ImGui::SameLine();
+							ImGui::InputInt("To##CopyPallete", &CopyTo);
+							ImGui::PopItemWidth();
+							CopyFrom = std::clamp(CopyFrom, 1, (std::max)(currentChar.Max_Pallete_Num, 1));
+							CopyTo = std::clamp(CopyTo, 1, (std::max)(currentChar.Max_Pallete_Num, 1));
+							ImGui::SameLine();
+							if (ImGui::Button("Copy pallete")) {
+								Game.CopyPallete(CopyFrom - 1, CopyTo - 1);
+							}
+							int Differences = Game.ComparePalletes(CopyFrom - 1, CopyTo - 1);
+							if (Differences >= 0) {
+								ImGui::SameLine();
+								ImGui::Text("%d values differ", Differences);
+							}
 							ImGui::Separator();
 
 							//    (  )
@@ -182,8 +227,8 @@ void Drawing::Draw()
 								//  : Don't display character
 								ImGui::TableNextRow();
 								ImGui::TableSetColumnIndex(0);
-								if (ImGui::Checkbox("Don't display character", &PalEdit::bNODisplayChar)) {
-									PalEdit::NODisplayChar();
+								if (ImGui::Checkbox("Don't display character", &Game.bNODisplayChar)) {
+									Game.NODisplayChar();
 								}
 
 								ImGui::TableSetColumnIndex(1);
@@ -195,15 +240,14 @@ void Drawing::Draw()
 										(static_cast<__int32>(LinecolorFloat[2] * 255));
 
 									currentChar.LineColor = LineColorValue;
-									PalEdit::ChangeLineColor();
-									PalEdit::Read_Character();
+									Game.ChangeLineColor();
 								}
 
 								//  : Don't display shadows
 								ImGui::TableNextRow();
 								ImGui::TableSetColumnIndex(0);
-								if (ImGui::Checkbox("Don't display shadows", &PalEdit::bNODisplayShadows)) {
-									PalEdit::NODisplayShadow();
+								if (ImGui::Checkbox("Don't display shadows", &Game.bNODisplayShadows)) {
+									Game.NODisplayShadow();
 								}
 
 								ImGui::TableSetColumnIndex(1);
@@ -215,15 +259,14 @@ void Drawing::Draw()
 										(static_cast<__int32>(fSuperShadow1[2] * 255));
 
 									currentChar.SuperShadowColor1 = ColorEdit;
-									PalEdit::ChangeSuperShadow1();
-									PalEdit::Read_Character();
+									Game.ChangeSuperShadow1();
 								}
 
 								//  : Display super shadow
 								ImGui::TableNextRow();
 								ImGui::TableSetColumnIndex(0);
-								if (ImGui::Checkbox("Display super shadow", &PalEdit::bDisplaySuperShadows)) {
-									PalEdit::DisplaySuperShadow();
+								if (ImGui::Checkbox("Display super shadow", &Game.bDisplaySuperShadows)) {
+									Game.DisplaySuperShadow();
 								}
 
 								ImGui::TableSetColumnIndex(1);
@@ -235,8 +278,7 @@ void Drawing::Draw()
 										(static_cast<__int32>(fSuperShadow2[2] * 255));
 
 									currentChar.SuperShadowColor2 = ColorEdit;
-									PalEdit::ChangeSuperShadow2();
-									PalEdit::Read_Character();
+									Game.ChangeSuperShadow2();
 								}
 								ImGui::TableNextRow();
 								ImGui::TableSetColumnIndex(0);
@@ -284,8 +326,7 @@ void Drawing::Draw()
 													(static_cast<__int32>(colorFloat[1] * 255) << 8) |
 													(static_cast<__int32>(colorFloat[2] * 255));
 
-												PalEdit::ChangeColor(i, colorValue);
-												PalEdit::Read_Character();
+												Game.ChangeColor(i, colorValue);
 											}
 
 											if (ImGui::IsItemHovered()) {
@@ -347,8 +388,7 @@ void Drawing::Draw()
 											(static_cast<__int32>(colorFloat[1] * 255) << 8) |   // Green
 											(static_cast<__int32>(colorFloat[2] * 255));         // Blue
 
-										PalEdit::ChangeColor(i, colorValue);
-										PalEdit::Read_Character();
+										Game.ChangeColor(i, colorValue);
 									}
 
 									ImGui::PopID();
@@ -374,7 +414,7 @@ void Drawing::Draw()
 							AutoPallete::save();
 						}
 						if (ImGui::Button("Reset Auto Palettes")) {
-							AutoPallete::init();
+							AutoPallete::init(Game);
 						}
 						ImGui::Separator();
 
@@ -509,9 +549,38 @@ void Drawing::Draw()
 
 						ImGui::EndTabItem();
 					}
+					if (ImGui::BeginTabItem("Stats")) {
+						// Counted by the watcher thread, per poll of the game
+						auto Snapshot = Game.Snapshot();
+						PollScheduler::Load Polling = Game.Polling();
+						ImGui::Text("Polling every %d ms: %.1f polls/s, %.1f reads/s, %.1f KB/s", Polling.IntervalMs,
+							Polling.PollsPerSecond, Polling.ReadsPerSecond, Polling.BytesPerSecond / 1024.0);
+						ImGui::Text("Looking for the game every %.1f s", PalEdit::DiscoveryIntervalMs() / 1000.0);
+						ImGui::Text("Pointer reads per poll: %d", Snapshot ? Snapshot->ChainReads : 0);
+						ImGui::Text("Pointer reads saved per poll: %d", Snapshot ? Snapshot->ChainReadsSaved : 0);
+						ImGui::Text("Color writes in last flush: %d (%d colors)", Game.WritesLastFlush(), Game.ColorsLastFlush());
+						const Memory::RemoteWriter& Writer = Game.Writer();
+						ImGui::Text("Last write batch: %d records in %d ranges, %llu writes waiting", Writer.RecordsLastBatch(), Writer.SpansLastBatch(),
+							static_cast<unsigned long long>(Writer.Queued() - Writer.Sent()));
+						if (Writer.BatchesOnFrame() + Writer.BatchesOffFrame() > 0) {
+							ImGui::Text("Batches sent on a new frame: %llu, without one: %llu, last waited %.1f ms",
+								static_cast<unsigned long long>(Writer.BatchesOnFrame()), static_cast<unsigned long long>(Writer.BatchesOffFrame()),
+								Writer.FrameWaitLastBatchUs() / 1000.0);
+						}
+						PalEdit::WriteReport Report = Game.LastUpdateReport();
+						ImGui::Text("Last auto-load: %zu bytes written, %zu bytes skipped", Report.BytesWritten, Report.BytesSkipped);
+						ImGui::Text("Mirrored palette pages: %zu", Snapshot ? Snapshot->MirroredPages : 0);
+						PalEdit::Divergence Diverged = Game.LastDivergence();
+						ImGui::Text("Differs from game: %d values in %d characters", Diverged.Values, Diverged.Characters);
+						ImGui::Checkbox("Verify writes", &PalEdit::bVerifyWrites);
+						PalEdit::VerifyReport Verify = Game.LastVerify();
+						ImGui::Text("Last check: %d ranges, %zu bytes read back, %d characters overwritten", Verify.Spans, Verify.BytesReadBack, Verify.Mismatches);
+						ImGui::EndTabItem();
+					}
 				}
 				ImGui::EndTabBar();
 				ImGui::End();
 		}
+		PalEdit::FlushAll();
 	}
 }
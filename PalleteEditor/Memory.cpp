@@ -1,14 +1,38 @@
 #include "pch.h"
 #include "Memory.h"
 #include "Utills.hpp"
+#ifndef _WIN32
+#include <sys/uio.h>
+#include <signal.h>
+#include <cerrno>
+#include <climits>
+#include <vector>
+#endif
 
 namespace Memory {
 
-    DWORD FindProcessId(const std::wstring& targetProcessName) {
-        DWORD pid = 0;
+    namespace {
+        // The running game: Win32 API on Windows, /proc and process_vm_readv/writev on Linux
+        class NativeBackend : public Backend {
+        public:
+            std::vector<DWORD> FindProcessIds(const std::wstring& targetProcessName) override;
+            DWORD GetModuleBaseAddress(DWORD dwProcessId, const std::wstring& ModuleName) override;
+            ProcessHandle OpenProcessHandle(DWORD dwProcessId) override;
+            void CloseProcessHandle(ProcessHandle hProcess) override;
+            bool IsProcessAlive(ProcessHandle hProcess) override;
+            bool Read(ProcessHandle hProcess, uintptr_t address, void* buffer, size_t size) override;
+            bool Write(ProcessHandle hProcess, uintptr_t address, const void* buffer, size_t size) override;
+            bool ReadScatter(ProcessHandle hProcess, const Span* spans, size_t count) override;
+            bool WriteScatter(ProcessHandle hProcess, const Span* spans, size_t count) override;
+        };
+    }
+
+#ifdef _WIN32
+    std::vector<DWORD> NativeBackend::FindProcessIds(const std::wstring& targetProcessName) {
+        std::vector<DWORD> pids;
         HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
         if (hSnapshot == INVALID_HANDLE_VALUE) {
-            return pid; //      
+            return pids; //      
         }
 
         PROCESSENTRY32 pe;
@@ -16,22 +40,21 @@ namespace Memory {
 
         if (!Process32First(hSnapshot, &pe)) {
             CloseHandle(hSnapshot);
-            return pid;
+            return pids;
         }
 
         do {
             //     
             if (Utills::to_lower(pe.szExeFile) == Utills::to_lower(targetProcessName)) {
-                pid = pe.th32ProcessID;
-                break;
+                pids.push_back(pe.th32ProcessID);
             }
         } while (Process32Next(hSnapshot, &pe));
 
         CloseHandle(hSnapshot);
-        return pid; //    PID (  )
+        return pids; //    PID (  )
     }
 
-    DWORD GetModuleBaseAddress(DWORD dwProcessId, std::wstring ModuleName) {
+    DWORD NativeBackend::GetModuleBaseAddress(DWORD dwProcessId, const std::wstring& ModuleName) {
         HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, dwProcessId);
         if (hSnapshot == INVALID_HANDLE_VALUE) {
             return 0; //     
@@ -54,4 +77,882 @@ namespace Memory {
         return dwModuleBaseAddress; //  0,    
     }
 
-}
\ No newline at end of file
+    ProcessHandle NativeBackend::OpenProcessHandle(DWORD dwProcessId) {
+        return OpenProcess(PROCESS_ALL_ACCESS, TRUE, dwProcessId);
+    }
+
+    void NativeBackend::CloseProcessHandle(ProcessHandle hProcess) {
+        CloseHandle(hProcess);
+    }
+
+    // The process handle gets signaled when the process exits
+    bool NativeBackend::IsProcessAlive(ProcessHandle hProcess) {
+        return WaitForSingleObject(hProcess, 0) == WAIT_TIMEOUT;
+    }
+
+    bool NativeBackend::Read(ProcessHandle hProcess, uintptr_t address, void* buffer, size_t size) {
+        SIZE_T bytesRead = 0;
+        return ReadProcessMemory(hProcess,
+            reinterpret_cast<LPCVOID>(address),
+            buffer,
+            size,
+            &bytesRead) && bytesRead == size;
+    }
+
+    bool NativeBackend::Write(ProcessHandle hProcess, uintptr_t address, const void* buffer, size_t size) {
+        SIZE_T bytesWritten = 0;
+        return WriteProcessMemory(hProcess,
+            reinterpret_cast<LPVOID>(address),
+            buffer,
+            size,
+            &bytesWritten) && bytesWritten == size;
+    }
+
+    bool NativeBackend::ReadScatter(ProcessHandle hProcess, const Span* spans, size_t count) {
+        bool bReadAll = true;
+        for (size_t i = 0; i < count; ++i) {
+            bReadAll &= Read(hProcess, spans[i].Address, spans[i].Buffer, spans[i].Size);
+        }
+        return bReadAll;
+    }
+
+    bool NativeBackend::WriteScatter(ProcessHandle hProcess, const Span* spans, size_t count) {
+        bool bWrittenAll = true;
+        for (size_t i = 0; i < count; ++i) {
+            bWrittenAll &= Write(hProcess, spans[i].Address, spans[i].Buffer, spans[i].Size);
+        }
+        return bWrittenAll;
+    }
+
+#else
+
+    namespace {
+        bool SameName(const std::string& name, const std::wstring& targetName) {
+            if (name.size() != targetName.size()) {
+                return false;
+            }
+            for (size_t i = 0; i < name.size(); ++i) {
+                if (std::towlower(static_cast<unsigned char>(name[i])) != std::towlower(targetName[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // File name part of a Linux or Windows (Wine) path
+        std::string FileName(const std::string& path) {
+            size_t slash = path.find_last_of("/\\");
+            return slash == std::string::npos ? path : path.substr(slash + 1);
+        }
+
+        // Moves every span with as few syscalls as the kernel allows
+        template<typename Transfer>
+        bool TransferScatter(pid_t pid, const Span* spans, size_t count, Transfer transfer) {
+            std::vector<iovec> local;
+            std::vector<iovec> remote;
+            for (size_t first = 0; first < count; first += IOV_MAX) {
+                size_t batch = (std::min)(count - first, static_cast<size_t>(IOV_MAX));
+                local.resize(batch);
+                remote.resize(batch);
+                ssize_t expected = 0;
+                for (size_t i = 0; i < batch; ++i) {
+                    const Span& span = spans[first + i];
+                    local[i] = { span.Buffer, span.Size };
+                    remote[i] = { reinterpret_cast<void*>(span.Address), span.Size };
+                    expected += static_cast<ssize_t>(span.Size);
+                }
+                if (transfer(pid, local.data(), batch, remote.data(), batch, 0) != expected) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    // Wine keeps the Windows executable name in comm (cut to 15 chars) and
+    // the Windows path in argv[0], so both are checked
+    std::vector<DWORD> NativeBackend::FindProcessIds(const std::wstring& targetProcessName) {
+        std::vector<DWORD> pids;
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator("/proc", error)) {
+            const std::string pidText = entry.path().filename().string();
+            if (pidText.find_first_not_of("0123456789") != std::string::npos) {
+                continue;
+            }
+
+            std::string comm;
+            std::ifstream commFile(entry.path() / "comm");
+            std::getline(commFile, comm);
+            if (SameName(comm, targetProcessName)) {
+                pids.push_back(static_cast<DWORD>(std::stoul(pidText)));
+                continue;
+            }
+
+            std::string argv0;
+            std::ifstream cmdlineFile(entry.path() / "cmdline", std::ios::binary);
+            std::getline(cmdlineFile, argv0, '\0');
+            if (SameName(FileName(argv0), targetProcessName)) {
+                pids.push_back(static_cast<DWORD>(std::stoul(pidText)));
+            }
+        }
+        return pids;
+    }
+
+    // Lowest mapping of the module file, /proc/pid/maps is sorted by address
+    DWORD NativeBackend::GetModuleBaseAddress(DWORD dwProcessId, const std::wstring& ModuleName) {
+        std::ifstream maps("/proc/" + std::to_string(dwProcessId) + "/maps");
+        std::string line;
+        while (std::getline(maps, line)) {
+            // start-end perms offset dev inode path
+            std::istringstream fields(line);
+            std::string range, perms, offset, device, inode, path;
+            fields >> range >> perms >> offset >> device >> inode;
+            std::getline(fields >> std::ws, path);
+            if (!path.empty() && SameName(FileName(path), ModuleName)) {
+                return static_cast<DWORD>(std::stoull(range, nullptr, 16));
+            }
+        }
+        return 0;
+    }
+
+    ProcessHandle NativeBackend::OpenProcessHandle(DWORD dwProcessId) {
+        return static_cast<pid_t>(dwProcessId);
+    }
+
+    void NativeBackend::CloseProcessHandle(ProcessHandle) {
+    }
+
+    // Signal 0 only checks that the pid exists, EPERM means it does but is not ours
+    bool NativeBackend::IsProcessAlive(ProcessHandle hProcess) {
+        return kill(hProcess, 0) == 0 || errno == EPERM;
+    }
+
+    bool NativeBackend::Read(ProcessHandle hProcess, uintptr_t address, void* buffer, size_t size) {
+        Span span{ address, buffer, size };
+        return ReadScatter(hProcess, &span, 1);
+    }
+
+    bool NativeBackend::Write(ProcessHandle hProcess, uintptr_t address, const void* buffer, size_t size) {
+        Span span{ address, const_cast<void*>(buffer), size };
+        return WriteScatter(hProcess, &span, 1);
+    }
+
+    bool NativeBackend::ReadScatter(ProcessHandle hProcess, const Span* spans, size_t count) {
+        return TransferScatter(hProcess, spans, count, process_vm_readv);
+    }
+
+    bool NativeBackend::WriteScatter(ProcessHandle hProcess, const Span* spans, size_t count) {
+        return TransferScatter(hProcess, spans, count, process_vm_writev);
+    }
+
+#endif
+
+    namespace {
+        NativeBackend s_Native;
+        Backend* s_Backend = &s_Native;
+        thread_local ReadCost s_ThreadReadCost = { 0, 0 };
+    }
+
+    void SetBackend(Backend* backend) {
+        s_Backend = backend != nullptr ? backend : &s_Native;
+    }
+
+    std::vector<DWORD> FindProcessIds(const std::wstring& targetProcessName) {
+        return s_Backend->FindProcessIds(targetProcessName);
+    }
+
+    DWORD FindProcessId(const std::wstring& targetProcessName) {
+        std::vector<DWORD> pids = FindProcessIds(targetProcessName);
+        return pids.empty() ? 0 : pids.front();
+    }
+
+    DWORD GetModuleBaseAddress(DWORD dwProcessId, std::wstring ModuleName) {
+        return s_Backend->GetModuleBaseAddress(dwProcessId, ModuleName);
+    }
+
+    ProcessHandle OpenProcessHandle(DWORD dwProcessId) {
+        return s_Backend->OpenProcessHandle(dwProcessId);
+    }
+
+    void CloseProcessHandle(ProcessHandle hProcess) {
+        s_Backend->CloseProcessHandle(hProcess);
+    }
+
+    bool IsProcessAlive(ProcessHandle hProcess) {
+        return s_Backend->IsProcessAlive(hProcess);
+    }
+
+    bool Read(ProcessHandle hProcess, uintptr_t address, void* buffer, size_t size) {
+        s_ThreadReadCost.Calls++;
+        s_ThreadReadCost.Bytes += size;
+        return s_Backend->Read(hProcess, address, buffer, size);
+    }
+
+    bool Write(ProcessHandle hProcess, uintptr_t address, const void* buffer, size_t size) {
+        return s_Backend->Write(hProcess, address, buffer, size);
+    }
+
+    bool ReadScatter(ProcessHandle hProcess, const Span* spans, size_t count) {
+        s_ThreadReadCost.Calls++;
+        for (size_t i = 0; i < count; ++i) {
+            s_ThreadReadCost.Bytes += spans[i].Size;
+        }
+        return s_Backend->ReadScatter(hProcess, spans, count);
+    }
+
+    bool WriteScatter(ProcessHandle hProcess, const Span* spans, size_t count) {
+        return s_Backend->WriteScatter(hProcess, spans, count);
+    }
+
+    bool ReadEach(ProcessHandle hProcess, const Span* spans, size_t count, std::vector<bool>* bRead) {
+        if (ReadScatter(hProcess, spans, count)) {
+            bRead->assign(count, true);
+            return true;
+        }
+        // A bad span fails the whole scatter read, find it one by one
+        bool bReadAll = true;
+        bRead->resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            (*bRead)[i] = Read(hProcess, spans[i].Address, spans[i].Buffer, spans[i].Size);
+            bReadAll &= (*bRead)[i];
+        }
+        return bReadAll;
+    }
+
+    ReadCost ThreadReadCost() {
+        return s_ThreadReadCost;
+    }
+
+    uint64_t Hash(const void* data, size_t size) {
+        const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+        const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+        const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+        auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+        uint64_t hash = PRIME3 + size;
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+            uint64_t lane;
+            memcpy(&lane, bytes + i, sizeof(lane));
+            hash ^= rotl(lane * PRIME2, 31) * PRIME1;
+            hash = rotl(hash, 27) * PRIME1 + PRIME2;
+        }
+        for (; i < size; ++i) {
+            hash ^= bytes[i] * PRIME3;
+            hash = rotl(hash, 11) * PRIME1;
+        }
+        // Final avalanche, every input bit reaches every output bit
+        hash ^= hash >> 33;
+        hash *= PRIME2;
+        hash ^= hash >> 29;
+        hash *= PRIME3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    size_t ChainCache::KeyHash::operator()(const Key& key) const {
+        size_t hash = std::hash<uintptr_t>{}(key.BaseAddress) ^ key.Depth;
+        for (size_t i = 0; i < key.Depth; ++i) {
+            hash = hash * 31 + std::hash<uintptr_t>{}(key.Offsets[i]);
+        }
+        return hash;
+    }
+
+    // Looks for the deepest prefix of key we already know, key.Offsets must hold the hops
+    size_t ChainCache::FindCachedPrefix(Key& key, size_t hops, uintptr_t* address) {
+        for (size_t depth = hops; depth > 0; --depth) {
+            key.Depth = depth;
+            auto it = Resolved.find(key);
+            if (it != Resolved.end()) {
+                *address = it->second;
+                ReadsSaved += static_cast<int>(depth);
+                return depth;
+            }
+        }
+        *address = key.BaseAddress;
+        return 0;
+    }
+
+    bool ChainCache::ResolveCached(ProcessHandle hProcess, uintptr_t baseAddress,
+        const uintptr_t* offsets, size_t count, uintptr_t* address) {
+        // Key for prefix [0..depth) is the pointer read after applying offsets[depth - 1]
+        const size_t hops = count - 1;
+        Key key{ baseAddress, 0, {} };
+        std::copy(offsets, offsets + hops, key.Offsets.begin());
+
+        uintptr_t currentAddress;
+        size_t start = FindCachedPrefix(key, hops, &currentAddress);
+
+        // Walk the rest of the chain and remember every pointer on the way
+        for (size_t i = start; i < hops; ++i) {
+            currentAddress += offsets[i];
+            if (ReadMirrored(&currentAddress)) {
+                ReadsSaved++;
+            }
+            else if (Dereference(hProcess, &currentAddress)) {
+                ReadsDone++;
+            }
+            else {
+                return false;
+            }
+
+            key.Depth = i + 1;
+            Resolved[key] = currentAddress;
+        }
+
+        *address = currentAddress + offsets[hops];
+        return true;
+    }
+
+    void ChainCache::ResolveBatch(ProcessHandle hProcess, uintptr_t baseAddress,
+        BatchEntry* entries, size_t count, bool bCached) {
+        // Where every chain stands: Hop is the next offset to follow
+        struct Walk {
+            Key Prefix;
+            size_t Hops;
+            size_t Hop;
+            uintptr_t Address;
+            bool bFailed;
+        };
+        auto Advance = [this, bCached](Walk& walk, uintptr_t pointer) {
+            walk.Address = pointer;
+            walk.Hop++;
+            if (bCached) {
+                walk.Prefix.Depth = walk.Hop;
+                Resolved[walk.Prefix] = walk.Address;
+            }
+        };
+        std::vector<Walk> walks(count);
+        size_t maxHops = 0;
+        for (size_t i = 0; i < count; ++i) {
+            Walk& walk = walks[i];
+            walk.Prefix = { baseAddress, 0, {} };
+            walk.Hops = entries[i].Count - 1;
+            std::copy(entries[i].Offsets, entries[i].Offsets + walk.Hops, walk.Prefix.Offsets.begin());
+            walk.Address = baseAddress;
+            walk.Hop = bCached ? FindCachedPrefix(walk.Prefix, walk.Hops, &walk.Address) : 0;
+            walk.bFailed = false;
+            maxHops = (std::max)(maxHops, walk.Hops);
+        }
+
+        std::unordered_map<uintptr_t, size_t> readOf;
+        std::vector<uintptr_t> addresses;
+        std::vector<RemotePointer> pointers;
+        std::vector<Span> spans;
+        std::vector<size_t> walkRead(count);
+        std::vector<bool> bRead;
+        for (size_t level = 0; level < maxHops; ++level) {
+            // Chains sharing a prefix ask for the same pointer, read it once
+            readOf.clear();
+            addresses.clear();
+            for (size_t i = 0; i < count; ++i) {
+                Walk& walk = walks[i];
+                if (walk.bFailed || walk.Hop != level || walk.Hop >= walk.Hops) {
+                    continue;
+                }
+                uintptr_t pointerAddress = walk.Address + entries[i].Offsets[level];
+                if (ReadMirrored(&pointerAddress)) {
+                    ReadsSaved++;
+                    Advance(walk, pointerAddress);
+                    continue;
+                }
+                auto [it, bNew] = readOf.emplace(pointerAddress, addresses.size());
+                if (bNew) {
+                    addresses.push_back(pointerAddress);
+                }
+                walkRead[i] = it->second;
+            }
+            if (addresses.empty()) {
+                continue;
+            }
+
+            pointers.assign(addresses.size(), 0);
+            spans.resize(addresses.size());
+            for (size_t r = 0; r < addresses.size(); ++r) {
+                spans[r] = { addresses[r], &pointers[r], sizeof(RemotePointer) };
+            }
+            ReadsDone += static_cast<int>(spans.size());
+
+            ReadEach(hProcess, spans.data(), spans.size(), &bRead);
+
+            for (size_t i = 0; i < count; ++i) {
+                Walk& walk = walks[i];
+                if (walk.bFailed || walk.Hop != level || walk.Hop >= walk.Hops) {
+                    continue;
+                }
+                if (!bRead[walkRead[i]]) {
+                    walk.bFailed = true;
+                    continue;
+                }
+                Advance(walk, pointers[walkRead[i]]);
+            }
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            entries[i].bResolved = !walks[i].bFailed;
+            if (entries[i].bResolved) {
+                entries[i].Address = walks[i].Address + entries[i].Offsets[walks[i].Hops];
+            }
+        }
+    }
+
+    bool ChainCache::ReadMirrored(uintptr_t* address) {
+        RemotePointer pointer;
+        if (Mirror == nullptr || !Mirror->Read(*address, &pointer)) {
+            return false;
+        }
+        *address = pointer;
+        return true;
+    }
+
+    bool ChainCache::ReadString(ProcessHandle hProcess, uintptr_t address, size_t maxLength,
+        std::string* result, bool bCached) {
+        const uintptr_t PAGE_SIZE = 0x1000;
+
+        if (bCached) {
+            auto it = Strings.find(address);
+            if (it != Strings.end()) {
+                *result = it->second;
+                return true;
+            }
+        }
+
+        // Read up to the end of the current page each time, so a block never
+        // crosses into a page that may not be mapped
+        std::string text;
+        char block[PAGE_SIZE];
+        uintptr_t currentAddress = address;
+        while (text.size() < maxLength - 1) {
+            size_t blockSize = PAGE_SIZE - (currentAddress & (PAGE_SIZE - 1));
+            blockSize = (std::min)(blockSize, maxLength - 1 - text.size());
+
+            if (!Read(hProcess, currentAddress, block, blockSize)) {
+                return false;
+            }
+
+            const char* terminator = static_cast<const char*>(memchr(block, '\0', blockSize));
+            if (terminator != nullptr) {
+                text.append(block, terminator - block);
+                break;
+            }
+            text.append(block, blockSize);
+            currentAddress += blockSize;
+        }
+
+        if (bCached) {
+            Strings[address] = text;
+        }
+        *result = std::move(text);
+        return true;
+    }
+
+    void PageMirror::Track(uintptr_t address, size_t size) {
+        ForEachPage(address, size, [this](uintptr_t pageStart, size_t, size_t, size_t) {
+            Page& page = Pages[pageStart];
+            if (page.Bytes.empty()) {
+                page.Bytes.resize(PAGE_SIZE);
+            }
+        });
+    }
+
+    bool PageMirror::Covers(uintptr_t address, size_t size) const {
+        bool bCovered = true;
+        ForEachPage(address, size, [&](uintptr_t pageStart, size_t, size_t, size_t) {
+            auto it = Pages.find(pageStart);
+            bCovered &= it != Pages.end() && it->second.bValid;
+        });
+        return bCovered;
+    }
+
+    bool PageMirror::Refresh(ProcessHandle hProcess) {
+        std::vector<Span> spans;
+        spans.reserve(Pages.size());
+        for (auto& [pageStart, page] : Pages) {
+            spans.push_back({ pageStart, page.Bytes.data(), PAGE_SIZE });
+        }
+        std::vector<bool> bRead;
+        bool bReadAll = ReadEach(hProcess, spans.data(), spans.size(), &bRead);
+        size_t i = 0;
+        for (auto& [pageStart, page] : Pages) {
+            page.bValid = bRead[i++];
+        }
+        return bReadAll;
+    }
+
+    bool PageMirror::Read(uintptr_t address, void* buffer, size_t size) const {
+        if (!Covers(address, size)) {
+            return false;
+        }
+        ForEachPage(address, size, [&](uintptr_t pageStart, size_t offset, size_t done, size_t length) {
+            memcpy(static_cast<char*>(buffer) + done, Pages.at(pageStart).Bytes.data() + offset, length);
+        });
+        return true;
+    }
+
+    void PageMirror::Patch(uintptr_t address, const void* data, size_t size) {
+        ForEachPage(address, size, [&](uintptr_t pageStart, size_t offset, size_t done, size_t length) {
+            auto it = Pages.find(pageStart);
+            if (it != Pages.end() && it->second.bValid) {
+                memcpy(it->second.Bytes.data() + offset, static_cast<const char*>(data) + done, length);
+            }
+        });
+    }
+
+    void PageMirror::Clear() {
+        Pages.clear();
+    }
+
+    int PatchSet::Add(uintptr_t address, std::vector<unsigned char> bytes, std::vector<unsigned char> original) {
+        Patch patch;
+        patch.Address = address;
+        patch.Bytes = std::move(bytes);
+        if (original.size() == patch.Bytes.size()) {
+            patch.Original = std::move(original);
+        }
+        Patches.push_back(std::move(patch));
+        return static_cast<int>(Patches.size()) - 1;
+    }
+
+    void PatchSet::Want(int patch, bool bApplied) {
+        if (patch >= 0 && patch < static_cast<int>(Patches.size())) {
+            Patches[patch].bWanted = bApplied;
+        }
+    }
+
+    bool PatchSet::IsApplied(int patch) const {
+        return patch >= 0 && patch < static_cast<int>(Patches.size()) && Patches[patch].bApplied;
+    }
+
+    bool PatchSet::Sync(ProcessHandle hProcess) {
+        if (Patches.empty()) {
+            return true;
+        }
+        std::vector<std::vector<unsigned char>> current(Patches.size());
+        std::vector<Span> spans;
+        spans.reserve(Patches.size());
+        for (size_t i = 0; i < Patches.size(); ++i) {
+            current[i].resize(Patches[i].Bytes.size());
+            spans.push_back({ Patches[i].Address, current[i].data(), current[i].size() });
+        }
+        if (!ReadScatter(hProcess, spans.data(), spans.size())) {
+            return false;
+        }
+
+        std::vector<size_t> removals;
+        std::vector<size_t> applies;
+        for (size_t i = 0; i < Patches.size(); ++i) {
+            Patch& patch = Patches[i];
+            patch.bApplied = current[i] == patch.Bytes;
+            if (!patch.bCaptured) {
+                patch.bCaptured = true;
+                // Already in (left by an earlier run): only an expected original can take it out
+                if (!patch.bApplied) {
+                    if (!patch.Original.empty() && current[i] != patch.Original) {
+                        patch.bUsable = false;
+                    }
+                    else {
+                        patch.Original = current[i];
+                    }
+                }
+            }
+            if (!patch.bUsable || patch.bApplied == patch.bWanted) {
+                continue;
+            }
+            if (patch.bWanted) {
+                applies.push_back(i);
+            }
+            else if (!patch.Original.empty()) {
+                removals.push_back(i);
+            }
+        }
+
+        std::vector<Span> writes;
+        for (auto it = removals.rbegin(); it != removals.rend(); ++it) {
+            Patch& patch = Patches[*it];
+            writes.push_back({ patch.Address, patch.Original.data(), patch.Original.size() });
+        }
+        for (size_t i : applies) {
+            Patch& patch = Patches[i];
+            writes.push_back({ patch.Address, patch.Bytes.data(), patch.Bytes.size() });
+        }
+        if (writes.empty()) {
+            return true;
+        }
+        if (!WriteScatter(hProcess, writes.data(), writes.size())) {
+            return false;
+        }
+        for (size_t i : removals) {
+            Patches[i].bApplied = false;
+        }
+        for (size_t i : applies) {
+            Patches[i].bApplied = true;
+        }
+        return true;
+    }
+
+    bool PatchSet::RestoreAll(ProcessHandle hProcess) {
+        for (Patch& patch : Patches) {
+            patch.bWanted = false;
+        }
+        return Sync(hProcess);
+    }
+
+    RemoteWriter::RemoteWriter() : Ring(std::make_unique<Record[]>(CAPACITY)) {
+    }
+
+    void RemoteWriter::Start() {
+        if (Thread.joinable()) {
+            return;
+        }
+        bRunning = true;
+        Thread = std::thread(&RemoteWriter::Run, this);
+    }
+
+    void RemoteWriter::Stop() {
+        if (!Thread.joinable()) {
+            return;
+        }
+        bRunning = false;
+        Signal.fetch_add(1);
+        Signal.notify_one();
+        Thread.join();
+    }
+
+    void RemoteWriter::Write(ProcessHandle hProcess, uintptr_t address, const void* data, size_t size) {
+        uint64_t write = WritesQueued.load() + 1;
+        WritesQueued.store(write);
+        if (!Thread.joinable()) {
+            // Nobody to hand it to, write it here
+            Memory::Write(hProcess, address, data, size);
+            WritesSent.store(write);
+            WritesSent.notify_all();
+            return;
+        }
+
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        size_t done = 0;
+        do {
+            while (Filled - Tail.load(std::memory_order_acquire) == CAPACITY) {
+                // The writer cannot free what it was not handed yet
+                Publish();
+                std::this_thread::yield();
+            }
+            Record& record = Ring[Filled & (CAPACITY - 1)];
+            size_t length = (std::min)(size - done, RECORD_SIZE);
+            record.Process = hProcess;
+            record.Address = address + done;
+            record.Size = static_cast<uint32_t>(length);
+            memcpy(record.Bytes, bytes + done, length);
+            done += length;
+            record.Write = done == size ? write : 0;
+            Filled++;
+        } while (done < size);
+        if (EditDepth == 0) {
+            Publish();
+        }
+    }
+
+    void RemoteWriter::EndEdit() {
+        if (--EditDepth == 0) {
+            Publish();
+        }
+    }
+
+    void RemoteWriter::Publish() {
+        if (Head.load(std::memory_order_relaxed) == Filled) {
+            return;
+        }
+        Head.store(Filled, std::memory_order_release);
+        Signal.fetch_add(1);
+        Signal.notify_one();
+    }
+
+    void RemoteWriter::Drain() {
+        uint64_t target = WritesQueued.load();
+        uint64_t sent;
+        while ((sent = WritesSent.load()) < target) {
+            WritesSent.wait(sent);
+        }
+    }
+
+    void RemoteWriter::Run() {
+        while (true) {
+            uint32_t signal = Signal.load();
+            size_t tail = Tail.load(std::memory_order_relaxed);
+            size_t head = Head.load(std::memory_order_acquire);
+            if (tail == head) {
+                if (!bRunning) {
+                    break;
+                }
+                Signal.wait(signal);
+                continue;
+            }
+
+            uintptr_t counter = FrameCounter.load();
+            if (counter != 0) {
+                auto start = std::chrono::steady_clock::now();
+                bool bOnFrame = WaitForFrame(Ring[tail & (CAPACITY - 1)].Process, counter);
+                (bOnFrame ? FramesSynced : FramesMissed).fetch_add(1);
+                LastFrameWaitUs = static_cast<int>(std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start).count());
+                // Edits queued while we waited make the same frame
+                head = Head.load(std::memory_order_acquire);
+            }
+
+            // Everything queued by now is one batch
+            Copied.clear();
+            Pieces.clear();
+            uint64_t written = 0;
+            int records = 0;
+            for (; tail != head; ++tail) {
+                const Record& record = Ring[tail & (CAPACITY - 1)];
+                Pieces.push_back({ record.Process, record.Address, record.Size, Copied.size(), Pieces.size() });
+                Copied.insert(Copied.end(), record.Bytes, record.Bytes + record.Size);
+                if (record.Write != 0) {
+                    written = record.Write;
+                }
+                records++;
+            }
+            // The records are copied out, the producer may reuse them while we write
+            Tail.store(tail, std::memory_order_release);
+
+            int spans = 0;
+            for (size_t first = 0; first < Pieces.size();) {
+                size_t last = first + 1;
+                while (last < Pieces.size() && Pieces[last].Process == Pieces[first].Process) {
+                    ++last;
+                }
+                spans += Send(Pieces[first].Process, Pieces.data() + first, last - first);
+                first = last;
+            }
+            LastBatchRecords = records;
+            LastBatchSpans = spans;
+            if (written != 0) {
+                WritesSent.store(written);
+                WritesSent.notify_all();
+            }
+        }
+    }
+
+    bool RemoteWriter::WaitForFrame(ProcessHandle hProcess, uintptr_t counterAddress) {
+        using Clock = std::chrono::steady_clock;
+        if (counterAddress != SyncedCounter) {
+            SyncedCounter = counterAddress;
+            LastFrameTime = Clock::time_point();
+            FramePeriod = Clock::duration::zero();
+        }
+        uint32_t frame;
+        if (!Read(hProcess, counterAddress, &frame, sizeof(frame))) {
+            return false;
+        }
+        const uint32_t current = frame;
+        Clock::time_point now = Clock::now();
+        Clock::time_point deadline = now + FRAME_WAIT_LIMIT;
+
+        // Once frames were timed, sleep through most of this one. The next one
+        // starts within a frame from now, whatever happened since we last looked.
+        Clock::time_point expected = Clock::time_point();
+        if (FramePeriod != Clock::duration::zero()) {
+            expected = (std::min)(now + FramePeriod, LastFrameTime + FramePeriod * (current - LastFrame + 1));
+            if (expected - FRAME_WAKE_EARLY > now) {
+                std::this_thread::sleep_until(expected - FRAME_WAKE_EARLY);
+            }
+        }
+        while (frame == current) {
+            now = Clock::now();
+            if (now >= deadline) {
+                // Not running frames right now, time them anew once it does
+                LastFrameTime = Clock::time_point();
+                FramePeriod = Clock::duration::zero();
+                return false;
+            }
+            // Close to the expected start only yield, a sleep may take longer than what is left
+            if (now < expected + FRAME_WAKE_EARLY) {
+                std::this_thread::yield();
+            }
+            else {
+                std::this_thread::sleep_for(FRAME_POLL);
+            }
+            if (!Read(hProcess, counterAddress, &frame, sizeof(frame))) {
+                return false;
+            }
+        }
+
+        // Both ends are frame starts as we saw them, frame - LastFrame frames apart
+        now = Clock::now();
+        if (LastFrameTime != Clock::time_point() && frame != LastFrame) {
+            Clock::duration period = (now - LastFrameTime) / (frame - LastFrame);
+            if (period < FRAME_WAIT_LIMIT) {
+                FramePeriod = period;
+            }
+        }
+        LastFrame = frame;
+        LastFrameTime = now;
+        return true;
+    }
+
+    int RemoteWriter::Send(ProcessHandle hProcess, Piece* pieces, size_t count) {
+        // By address, pieces at the same address stay in queue order
+        std::stable_sort(pieces, pieces + count, [](const Piece& a, const Piece& b) { return a.Address < b.Address; });
+        Merged.clear();
+        Runs.clear();
+        size_t i = 0;
+        while (i < count) {
+            // Pieces that overlap or touch become one run
+            uintptr_t start = pieces[i].Address;
+            uintptr_t end = start + pieces[i].Size;
+            size_t next = i + 1;
+            while (next < count && pieces[next].Address <= end) {
+                end = (std::max)(end, pieces[next].Address + pieces[next].Size);
+                ++next;
+            }
+            // Laid down oldest first, so a later value of a byte replaces an earlier one
+            if (next - i > 1) {
+                std::sort(pieces + i, pieces + next, [](const Piece& a, const Piece& b) { return a.Order < b.Order; });
+            }
+            size_t offset = Merged.size();
+            Merged.resize(offset + (end - start));
+            for (size_t k = i; k < next; ++k) {
+                memcpy(Merged.data() + offset + (pieces[k].Address - start), Copied.data() + pieces[k].Offset, pieces[k].Size);
+            }
+            Runs.push_back({ start, nullptr, end - start });
+            i = next;
+        }
+        // Merged may have moved while it grew
+        size_t offset = 0;
+        for (Span& run : Runs) {
+            run.Buffer = Merged.data() + offset;
+            offset += run.Size;
+        }
+        WriteScatter(hProcess, Runs.data(), Runs.size());
+        return static_cast<int>(Runs.size());
+    }
+
+    void ChainCache::ForgetPrefix(uintptr_t baseAddress, const uintptr_t* hops, size_t count) {
+        for (auto it = Resolved.begin(); it != Resolved.end();) {
+            const Key& key = it->first;
+            if (key.BaseAddress == baseAddress && key.Depth >= count &&
+                std::equal(hops, hops + count, key.Offsets.begin())) {
+                it = Resolved.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+        Strings.clear();
+    }
+
+    void ChainCache::Invalidate() {
+        Resolved.clear();
+        Strings.clear();
+    }
+
+    void ChainCache::BeginFrame() {
+        SavedLastFrame = ReadsSaved;
+        DoneLastFrame = ReadsDone;
+        ReadsSaved = 0;
+        ReadsDone = 0;
+    }
+
+}
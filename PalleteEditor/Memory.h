@@ -1,126 +1,429 @@
 #pragma once
 #include "pch.h"
+#include <array>
+#include <string>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <chrono>
 
 namespace Memory{
+#ifdef _WIN32
+    using ProcessHandle = HANDLE;
+#else
+    // Under Wine/Proton the game is a plain Linux process, addressed by its pid
+    using ProcessHandle = pid_t;
+#endif
+    // Skullgirls is a 32-bit program, its pointers are 4 bytes wide on every host
+    using RemotePointer = uint32_t;
+
+    // One remote range of a scatter/gather transfer
+    struct Span {
+        uintptr_t Address;
+        void* Buffer;
+        size_t Size;
+    };
+
+    // What the functions below talk to. The default backend is the running game,
+    // SimulatedGame (SimulatedGame.h) stands in for it without one.
+    class Backend {
+    public:
+        virtual ~Backend() = default;
+        // Every running process of that name, one per game instance
+        virtual std::vector<DWORD> FindProcessIds(const std::wstring& targetProcessName) = 0;
+        virtual DWORD GetModuleBaseAddress(DWORD dwProcessId, const std::wstring& ModuleName) = 0;
+        virtual ProcessHandle OpenProcessHandle(DWORD dwProcessId) = 0;
+        virtual void CloseProcessHandle(ProcessHandle hProcess) = 0;
+        virtual bool IsProcessAlive(ProcessHandle hProcess) = 0;
+        virtual bool Read(ProcessHandle hProcess, uintptr_t address, void* buffer, size_t size) = 0;
+        virtual bool Write(ProcessHandle hProcess, uintptr_t address, const void* buffer, size_t size) = 0;
+        virtual bool ReadScatter(ProcessHandle hProcess, const Span* spans, size_t count) = 0;
+        virtual bool WriteScatter(ProcessHandle hProcess, const Span* spans, size_t count) = 0;
+    };
+    // nullptr goes back to the running game. The backend must outlive its use.
+    void SetBackend(Backend* backend);
+
+	std::vector<DWORD> FindProcessIds(const std::wstring& targetProcessName);
+    // The first of FindProcessIds, 0 if there is none
 	DWORD FindProcessId(const std::wstring& targetProcessName);
 	DWORD GetModuleBaseAddress(DWORD dwProcessId, std::wstring ModuleName);
+    ProcessHandle OpenProcessHandle(DWORD dwProcessId);
+    void CloseProcessHandle(ProcessHandle hProcess);
+    // Does not block: on Windows a zero-timeout wait on the handle
+    bool IsProcessAlive(ProcessHandle hProcess);
 
-    template<typename T>
-    bool ReadProcessMemoryWithOffsets(HANDLE hProcess, uintptr_t baseAddress,
-        const std::vector<uintptr_t>& offsets, T* result) {
-        uintptr_t currentAddress = baseAddress;
+    // Raw access to the game memory, true only if every byte was transferred
+    bool Read(ProcessHandle hProcess, uintptr_t address, void* buffer, size_t size);
+    bool Write(ProcessHandle hProcess, uintptr_t address, const void* buffer, size_t size);
 
-        //      
-        for (size_t i = 0; i < offsets.size(); ++i) {
-            currentAddress += offsets[i];
-
-            //     ,   
-            if (i < offsets.size() - 1) {
-                uintptr_t nextAddress;
-                if (!ReadProcessMemory(hProcess,
-                    reinterpret_cast<LPCVOID>(currentAddress),
-                    &nextAddress,
-                    sizeof(nextAddress),
-                    nullptr)) {
-                    return false;
-                }
-                currentAddress = nextAddress;
-            }
+    // Transfers every span. On Linux that is a single process_vm_readv/writev
+    // call (split every IOV_MAX spans), on Windows one call per span.
+    bool ReadScatter(ProcessHandle hProcess, const Span* spans, size_t count);
+    bool WriteScatter(ProcessHandle hProcess, const Span* spans, size_t count);
+    // Scatter read that also tells which spans came in: one call while every
+    // span is readable, span by span once one of them is not
+    bool ReadEach(ProcessHandle hProcess, const Span* spans, size_t count, std::vector<bool>* bRead);
+    // Reads the calling thread made so far (backend calls and bytes asked for),
+    // the difference over a piece of work is what it cost the game
+    struct ReadCost {
+        uint64_t Calls;
+        uint64_t Bytes;
+    };
+    ReadCost ThreadReadCost();
+    // Fast non-cryptographic 64-bit hash (xxHash64-style rounds), to compare ranges
+    uint64_t Hash(const void* data, size_t size);
+
+    // Pointer chain: every offset but the last one is added and dereferenced,
+    // the last one is added to get the final address. Named chains live in Chains.h.
+    template<size_t N>
+    using Chain = std::array<uintptr_t, N>;
+
+    template<typename... Offsets>
+    Chain<sizeof...(Offsets)> MakeChain(Offsets... offsets) {
+        return { static_cast<uintptr_t>(offsets)... };
+    }
+
+    inline bool Dereference(ProcessHandle hProcess, uintptr_t* address) {
+        RemotePointer pointer;
+        if (!Read(hProcess, *address, &pointer, sizeof(pointer))) {
+            return false;
         }
+        *address = pointer;
+        return true;
+    }
 
-        //      
-        std::cout << currentAddress;
-        return ReadProcessMemory(hProcess,
-            reinterpret_cast<LPCVOID>(currentAddress),
-            result,
-            sizeof(T),
-            nullptr);
+    template<size_t N, size_t... Hop>
+    bool WalkChain(ProcessHandle hProcess, const Chain<N>& chain, uintptr_t* address, std::index_sequence<Hop...>) {
+        return ((*address += chain[Hop], Dereference(hProcess, address)) && ...);
     }
 
-    //     (ANSI)
-    template<>
-    inline  bool ReadProcessMemoryWithOffsets<std::string>(HANDLE hProcess, uintptr_t baseAddress,
-        const std::vector<uintptr_t>& offsets, std::string* result) {
+    // Walks every hop of the chain except the last one and returns the final address.
+    // N is known at compile time, so the walk is unrolled into N - 1 reads.
+    template<size_t N>
+    bool ResolvePointerChain(ProcessHandle hProcess, uintptr_t baseAddress,
+        const Chain<N>& chain, uintptr_t* address) {
+        static_assert(N > 0, "Empty pointer chain");
         uintptr_t currentAddress = baseAddress;
-        const size_t MAX_STRING_LENGTH = 4096; //   
+        if (!WalkChain(hProcess, chain, &currentAddress, std::make_index_sequence<N - 1>{})) {
+            return false;
+        }
+        *address = currentAddress + chain[N - 1];
+        return true;
+    }
 
-        //      
-        for (size_t i = 0; i < offsets.size(); ++i) {
-            currentAddress += offsets[i];
-
-            //     ,   
-            if (i < offsets.size() - 1) {
-                uintptr_t nextAddress;
-                if (!ReadProcessMemory(hProcess,
-                    reinterpret_cast<LPCVOID>(currentAddress),
-                    &nextAddress,
-                    sizeof(nextAddress),
-                    nullptr)) {
-                    return false;
-                }
-                currentAddress = nextAddress;
-            }
+    // Local copy of whole remote pages. Ranges are tracked once, Refresh brings every
+    // tracked page up to date with one scatter read and reads are served locally.
+    class PageMirror {
+    public:
+        static constexpr uintptr_t PAGE_SIZE = 0x1000;
+
+        // Starts mirroring every page the range touches, they fill on the next Refresh
+        void Track(uintptr_t address, size_t size);
+        // True if every page of the range came in with the last Refresh
+        bool Covers(uintptr_t address, size_t size) const;
+        bool Refresh(ProcessHandle hProcess);
+        bool Read(uintptr_t address, void* buffer, size_t size) const;
+        template<typename T>
+        bool Read(uintptr_t address, T* value) const {
+            return Read(address, value, sizeof(T));
         }
+        // Applies our own write to the pages we hold, so they stay in step until the next Refresh
+        void Patch(uintptr_t address, const void* data, size_t size);
+        void Clear();
+        size_t PageCount() const { return Pages.size(); }
 
-        //        
-        char buffer[MAX_STRING_LENGTH];
-        SIZE_T bytesRead;
-
-        for (size_t i = 0; i < MAX_STRING_LENGTH; ++i) {
-            char currentChar;
-            if (!ReadProcessMemory(hProcess,
-                reinterpret_cast<LPCVOID>(currentAddress + i),
-                &currentChar,
-                sizeof(char),
-                &bytesRead) || bytesRead != sizeof(char)) {
-                return false;
+    private:
+        struct Page {
+            std::vector<char> Bytes;
+            bool bValid = false;
+        };
+        // Calls visit(page start, offset in page, offset in range, length) for every page of the range
+        template<typename Visit>
+        static void ForEachPage(uintptr_t address, size_t size, Visit visit) {
+            size_t done = 0;
+            while (done < size) {
+                uintptr_t current = address + done;
+                uintptr_t pageStart = current & ~(PAGE_SIZE - 1);
+                size_t offset = current - pageStart;
+                size_t length = (std::min)(size - done, static_cast<size_t>(PAGE_SIZE - offset));
+                visit(pageStart, offset, done, length);
+                done += length;
             }
+        }
+
+        std::map<uintptr_t, Page> Pages;
+    };
+
+    // Code patches of one process. A patch takes the bytes it replaces from the game
+    // the first time Sync sees them, so removing it puts back what this build had.
+    // Sync reads every patched range with one scatter read and writes only the
+    // ranges that are not in the wanted state.
+    class PatchSet {
+    public:
+        // Original, if given, is what the game is expected to hold there. A range holding
+        // neither it nor the patch belongs to another build and is never written.
+        int Add(uintptr_t address, std::vector<unsigned char> bytes, std::vector<unsigned char> original = {});
+        void Want(int patch, bool bApplied);
+        bool IsApplied(int patch) const;
+        // Patches go in in the order they were added and come out in reverse,
+        // so a jump is never written before the code it leads to
+        bool Sync(ProcessHandle hProcess);
+        // Wants every patch removed and syncs
+        bool RestoreAll(ProcessHandle hProcess);
+        void Clear() { Patches.clear(); }
+
+    private:
+        struct Patch {
+            uintptr_t Address;
+            std::vector<unsigned char> Bytes;
+            std::vector<unsigned char> Original;
+            bool bCaptured = false;
+            bool bUsable = true;
+            bool bWanted = false;
+            bool bApplied = false;
+        };
+        std::vector<Patch> Patches;
+    };
+
+    // Sends writes to the game from a thread of its own, so the caller never waits
+    // on the remote side. Write pushes into a lock-free single-producer/single-consumer
+    // ring; the writer thread takes everything there is, keeps the latest value of
+    // every address and sends the batch with one scatter write per process.
+    // With a frame counter set, every batch waits for the game to start a new frame,
+    // so an edit never shows half written for a frame.
+    class RemoteWriter {
+    public:
+        // Bytes per ring record, longer writes take several
+        static constexpr size_t RECORD_SIZE = 64;
+        static constexpr size_t CAPACITY = 1024; // records, a power of two
+        // A paused, minimized or loading game does not count frames, send without it then
+        static constexpr std::chrono::milliseconds FRAME_WAIT_LIMIT{ 50 };
+        // Polls the counter this often until the next frame is close
+        static constexpr std::chrono::microseconds FRAME_POLL{ 500 };
+        // Wakes up this long before the next frame is expected, then polls without sleeping
+        static constexpr std::chrono::microseconds FRAME_WAKE_EARLY{ 2000 };
 
-            if (currentChar == '\0') {
-                buffer[i] = '\0';
-                *result = std::string(buffer, i);
-                return true;
+        RemoteWriter();
+        ~RemoteWriter() { Stop(); }
+        void Start();
+        // Sends what is queued, then ends the thread
+        void Stop();
+        // Producer side, one thread only. Waits only while the ring is full.
+        void Write(ProcessHandle hProcess, uintptr_t address, const void* data, size_t size);
+        // Producer side: the writes between BeginEdit and EndEdit reach the writer
+        // thread together and go out in one batch. Nests, the outermost EndEdit sends.
+        // An edit larger than the ring goes out in parts.
+        void BeginEdit() { EditDepth++; }
+        void EndEdit();
+        // Waits until every write queued so far was sent. Not inside an edit.
+        void Drain();
+        // Address of the game's frame counter (a 32-bit value that goes up once a
+        // frame), every batch goes out right after it moves on. 0 sends at once.
+        void SyncToFrames(uintptr_t counterAddress) { FrameCounter.store(counterAddress); }
+        // Writes queued so far, and how many of them were sent (successfully or not)
+        uint64_t Queued() const { return WritesQueued.load(); }
+        uint64_t Sent() const { return WritesSent.load(); }
+        // Ring records of the last batch and the scatter spans they became
+        int RecordsLastBatch() const { return LastBatchRecords.load(); }
+        int SpansLastBatch() const { return LastBatchSpans.load(); }
+        // Batches sent right after a new frame started, and those that gave up waiting
+        uint64_t BatchesOnFrame() const { return FramesSynced.load(); }
+        uint64_t BatchesOffFrame() const { return FramesMissed.load(); }
+        // How long the last batch waited for its frame
+        int FrameWaitLastBatchUs() const { return LastFrameWaitUs.load(); }
+
+    private:
+        struct Record {
+            ProcessHandle Process;
+            uintptr_t Address;
+            uint32_t Size;
+            uint64_t Write; // Queued() once this record is sent, on the last record of a write
+            unsigned char Bytes[RECORD_SIZE];
+        };
+        void Run();
+        // Producer side: hands the records filled so far to the writer thread
+        void Publish();
+        // Writer thread: waits for the frame counter to move on. False if it did not
+        // within FRAME_WAIT_LIMIT or cannot be read.
+        bool WaitForFrame(ProcessHandle hProcess, uintptr_t counterAddress);
+        // A record's bytes copied out of the ring, Order is its place in the batch
+        struct Piece {
+            ProcessHandle Process;
+            uintptr_t Address;
+            size_t Size;
+            size_t Offset; // in Copied
+            size_t Order;
+        };
+        // Merges pieces that overlap or touch into runs and writes every run as one
+        // span, returns the span count. Reorders the pieces.
+        int Send(ProcessHandle hProcess, Piece* pieces, size_t count);
+
+        std::unique_ptr<Record[]> Ring;
+        std::atomic<size_t> Head{ 0 }; // first record the writer may not take yet
+        std::atomic<size_t> Tail{ 0 }; // next record the writer takes
+        // Producer only: next record to fill, ahead of Head while an edit is open
+        size_t Filled = 0;
+        int EditDepth = 0;
+        // Bumped on every push and on Stop, the writer sleeps on it
+        std::atomic<uint32_t> Signal{ 0 };
+        std::atomic<bool> bRunning{ false };
+        std::thread Thread;
+        std::atomic<uint64_t> WritesQueued{ 0 };
+        std::atomic<uint64_t> WritesSent{ 0 };
+        std::atomic<int> LastBatchRecords{ 0 };
+        std::atomic<int> LastBatchSpans{ 0 };
+        // Writer thread only, kept between batches so they do not allocate once grown
+        std::vector<unsigned char> Copied;
+        std::vector<Piece> Pieces;
+        std::vector<unsigned char> Merged;
+        std::vector<Span> Runs;
+
+        std::atomic<uintptr_t> FrameCounter{ 0 };
+        std::atomic<uint64_t> FramesSynced{ 0 };
+        std::atomic<uint64_t> FramesMissed{ 0 };
+        std::atomic<int> LastFrameWaitUs{ 0 };
+        // Writer thread only: the last frame seen to start and how long frames take,
+        // for the counter at SyncedCounter
+        uintptr_t SyncedCounter = 0;
+        uint32_t LastFrame = 0;
+        std::chrono::steady_clock::time_point LastFrameTime;
+        std::chrono::steady_clock::duration FramePeriod{};
+    };
+
+    // Cache of resolved intermediate pointers, keyed by chain prefix, and of
+    // strings keyed by their remote address.
+    // Every PalEdit session has its own. It drops the whole cache when the game
+    // opens/closes or a match starts/ends, and only the moved slot (Forget) when
+    // the game reallocates a character's buffers mid-match.
+    class ChainCache {
+    public:
+        static constexpr size_t MAX_DEPTH = 8;
+
+        template<size_t N>
+        bool Resolve(ProcessHandle hProcess, uintptr_t baseAddress,
+            const Chain<N>& chain, uintptr_t* address, bool bCached = true) {
+            static_assert(N > 0 && N <= MAX_DEPTH, "Pointer chain too deep for the cache");
+            if (!bCached) {
+                ReadsDone += static_cast<int>(N - 1);
+                return ResolvePointerChain(hProcess, baseAddress, chain, address);
             }
+            return ResolveCached(hProcess, baseAddress, chain.data(), N, address);
+        }
 
-            buffer[i] = currentChar;
+        // One chain of a batch. Offsets must outlive the ResolveBatch call.
+        struct BatchEntry {
+            const uintptr_t* Offsets;
+            size_t Count;
+            uintptr_t Address;
+            bool bResolved;
+        };
+        template<size_t N>
+        static BatchEntry Entry(const Chain<N>& chain) {
+            static_assert(N > 0 && N <= MAX_DEPTH, "Pointer chain too deep for the cache");
+            return { chain.data(), N, 0, false };
         }
+        // Stores the pointer found by following every offset of hops, for pointers
+        // fetched some other way (e.g. as a field of a RemoteView)
+        template<size_t N>
+        void Remember(uintptr_t baseAddress, const Chain<N>& hops, uintptr_t pointer) {
+            static_assert(N > 0 && N < MAX_DEPTH, "Pointer chain too deep for the cache");
+            Key key{ baseAddress, N, {} };
+            std::copy(hops.begin(), hops.end(), key.Offsets.begin());
+            Resolved[key] = pointer;
+        }
+        // Drops every cached pointer found through hops (and hops itself), for when
+        // the game moved the buffer hops leads to. Cached strings go too, their
+        // addresses may be reused by the new buffer.
+        template<size_t N>
+        void Forget(uintptr_t baseAddress, const Chain<N>& hops) {
+            static_assert(N > 0 && N < MAX_DEPTH, "Pointer chain too deep for the cache");
+            ForgetPrefix(baseAddress, hops.data(), N);
+        }
+        // Resolves all chains together, level by level: every level is one
+        // scatter read of the distinct pointers the chains need at that depth
+        void ResolveBatch(ProcessHandle hProcess, uintptr_t baseAddress,
+            BatchEntry* entries, size_t count, bool bCached = true);
+        // Reads a null-terminated string in page-sized blocks
+        bool ReadString(ProcessHandle hProcess, uintptr_t address, size_t maxLength,
+            std::string* result, bool bCached = true);
+        // Pointers found in the mirror are taken from there instead of the game
+        void SetMirror(const PageMirror* mirror) { Mirror = mirror; }
+        void Invalidate();
+        void BeginFrame();
+        int ReadsSavedLastFrame() const { return SavedLastFrame; }
+        int ReadsDoneLastFrame() const { return DoneLastFrame; }
 
-        //        MAX_STRING_LENGTH
-        buffer[MAX_STRING_LENGTH - 1] = '\0';
-        *result = std::string(buffer);
-        return true;
+    private:
+        struct Key {
+            uintptr_t BaseAddress;
+            size_t Depth;
+            std::array<uintptr_t, MAX_DEPTH> Offsets;
+            bool operator==(const Key& other) const {
+                return BaseAddress == other.BaseAddress && Depth == other.Depth &&
+                    std::equal(Offsets.begin(), Offsets.begin() + Depth, other.Offsets.begin());
+            }
+        };
+        struct KeyHash {
+            size_t operator()(const Key& key) const;
+        };
+
+        bool ResolveCached(ProcessHandle hProcess, uintptr_t baseAddress,
+            const uintptr_t* offsets, size_t count, uintptr_t* address);
+        size_t FindCachedPrefix(Key& key, size_t hops, uintptr_t* address);
+        bool ReadMirrored(uintptr_t* address);
+        void ForgetPrefix(uintptr_t baseAddress, const uintptr_t* hops, size_t count);
+
+        std::unordered_map<Key, uintptr_t, KeyHash> Resolved;
+        std::unordered_map<uintptr_t, std::string> Strings;
+        const PageMirror* Mirror = nullptr;
+        int ReadsSaved = 0;
+        int ReadsDone = 0;
+        int SavedLastFrame = 0;
+        int DoneLastFrame = 0;
+    };
+
+    // Through the cache if there is one, hop by hop from the game otherwise
+    template<size_t N>
+    bool ResolveWith(ChainCache* cache, ProcessHandle hProcess, uintptr_t baseAddress,
+        const Chain<N>& chain, uintptr_t* address) {
+        if (cache == nullptr) {
+            return ResolvePointerChain(hProcess, baseAddress, chain, address);
+        }
+        return cache->Resolve(hProcess, baseAddress, chain, address);
     }
 
+    template<typename T, size_t N>
+    bool ReadProcessMemoryWithOffsets(ProcessHandle hProcess, uintptr_t baseAddress,
+        const Chain<N>& chain, T* result, ChainCache* cache = nullptr) {
+        uintptr_t currentAddress;
+        if (!ResolveWith(cache, hProcess, baseAddress, chain, &currentAddress)) {
+            return false;
+        }
 
-    template<typename T>
-    bool WriteProcessMemoryWithOffsets(HANDLE hProcess, uintptr_t baseAddress,
-        const std::vector<uintptr_t>& offsets, const T& value) {
-        uintptr_t currentAddress = baseAddress;
+        //      
+        return Read(hProcess, currentAddress, result, sizeof(T));
+    }
 
-        //      
-        for (size_t i = 0; i < offsets.size(); ++i) {
-            currentAddress += offsets[i];
-
-            //     ,   
-            if (i < offsets.size() - 1) {
-                uintptr_t nextAddress;
-                if (!ReadProcessMemory(hProcess,
-                    reinterpret_cast<LPCVOID>(currentAddress),
-                    &nextAddress,
-                    sizeof(nextAddress),
-                    nullptr)) {
-                    return false;
-                }
-                currentAddress = nextAddress;
-            }
+    //     (ANSI)
+    template<size_t N>
+    bool ReadProcessMemoryWithOffsets(ProcessHandle hProcess, uintptr_t baseAddress,
+        const Chain<N>& chain, std::string* result, ChainCache* cache = nullptr) {
+        uintptr_t currentAddress;
+        const size_t MAX_STRING_LENGTH = 4096; //   
+
+        if (!ResolveWith(cache, hProcess, baseAddress, chain, &currentAddress)) {
+            return false;
         }
 
-        //     
-        return WriteProcessMemory(hProcess,
-            reinterpret_cast<LPVOID>(currentAddress),
-            &value,
-            sizeof(T),
-            nullptr);
+        if (cache == nullptr) {
+            ChainCache uncached;
+            return uncached.ReadString(hProcess, currentAddress, MAX_STRING_LENGTH, result, false);
+        }
+        return cache->ReadString(hProcess, currentAddress, MAX_STRING_LENGTH, result);
     }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,55 @@
+#include "pch.h"
+#include "PaletteModel.h"
+
+PaletteModel::PaletteModel() : Latest(std::make_shared<const Version>()) {
+}
+
+std::shared_ptr<const Character> PaletteModel::Version::Find(int ID) const {
+    for (const auto& Ch : Characters) {
+        if (Ch->ID == ID) {
+            return Ch;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const PaletteModel::Version> PaletteModel::Commit(const std::vector<Character>& Changed) {
+    return Publish([&](Version& Next) {
+        for (const Character& Ch : Changed) {
+            auto Copy = std::make_shared<const Character>(Ch);
+            auto it = std::find_if(Next.Characters.begin(), Next.Characters.end(),
+                [&](const std::shared_ptr<const Character>& Other) { return Other->ID == Ch.ID; });
+            if (it != Next.Characters.end()) {
+                *it = std::move(Copy);
+            }
+            else {
+                Next.Characters.push_back(std::move(Copy));
+            }
+        }
+        return true;
+    });
+}
+
+std::shared_ptr<const PaletteModel::Version> PaletteModel::Replace(const std::vector<Character>& Roster) {
+    return Publish([&](Version& Next) {
+        Version Before;
+        Before.Characters.swap(Next.Characters);
+        for (const Character& Ch : Roster) {
+            std::shared_ptr<const Character> Old = Before.Find(Ch.ID);
+            Next.Characters.push_back(Old && Same(*Old, Ch) ? Old : std::make_shared<const Character>(Ch));
+        }
+        return true;
+    });
+}
+
+bool PaletteModel::Same(const Character& First, const Character& Second) {
+    return First.ID == Second.ID &&
+        First.Current_Pallete_Num == Second.Current_Pallete_Num &&
+        First.Max_Pallete_Num == Second.Max_Pallete_Num &&
+        First.Num_Of_Color == Second.Num_Of_Color &&
+        First.LineColor == Second.LineColor &&
+        First.SuperShadowColor1 == Second.SuperShadowColor1 &&
+        First.SuperShadowColor2 == Second.SuperShadowColor2 &&
+        First.Character_Colors == Second.Character_Colors &&
+        First.Char_Name == Second.Char_Name;
+}
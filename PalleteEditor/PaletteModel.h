@@ -0,0 +1,71 @@
+#pragma once
+#include "pch.h"
+#include "Character.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// The palettes of a session's roster as a chain of immutable versions. A version
+// never changes once published: any thread takes the current one with a single
+// atomic load and may keep it as long as it likes. The load is lock-free where the
+// library makes shared_ptr atomics so, MSVC guards them with a short internal lock
+// that is never held while a version is built. A writer publishes a new version in
+// which only the characters it touched are new copies, every other character is
+// shared with the version before.
+class PaletteModel {
+public:
+	struct Version {
+		// Goes up by one with every version
+		uint64_t Number;
+		// In roster order
+		std::vector<std::shared_ptr<const Character>> Characters;
+		std::shared_ptr<const Character> Find(int ID) const;
+	};
+
+	PaletteModel();
+	std::shared_ptr<const Version> Current() const { return Latest.load(); }
+	// Publishes these characters in place of the ones with their IDs, characters
+	// not in the roster yet are added at its end. Returns the new version.
+	std::shared_ptr<const Version> Commit(const std::vector<Character>& Changed);
+	// Publishes a whole new roster. Characters that equal the current ones stay shared.
+	std::shared_ptr<const Version> Replace(const std::vector<Character>& Roster);
+	// Changes a copy of character ID and publishes it, false if there is none. Change
+	// runs again on the newer character if another writer published in the meantime.
+	template<typename F>
+	bool Edit(int ID, F&& Change) {
+		return Publish([&](Version& Next) {
+			for (auto& Ch : Next.Characters) {
+				if (Ch->ID == ID) {
+					auto Copy = std::make_shared<Character>(*Ch);
+					Change(*Copy);
+					Ch = std::move(Copy);
+					return true;
+				}
+			}
+			return false;
+		}) != nullptr;
+	}
+	// Same palettes, name and slot
+	static bool Same(const Character& First, const Character& Second);
+
+private:
+	// Builds the next version from a copy of the current one and swaps it in, builds
+	// it again if another writer got in first. Build returns false to publish nothing.
+	template<typename F>
+	std::shared_ptr<const Version> Publish(F&& Build) {
+		std::shared_ptr<const Version> Base = Latest.load();
+		while (true) {
+			auto Next = std::make_shared<Version>(*Base);
+			Next->Number = Base->Number + 1;
+			if (!Build(*Next)) {
+				return nullptr;
+			}
+			std::shared_ptr<const Version> Published = std::move(Next);
+			if (Latest.compare_exchange_weak(Base, Published)) {
+				return Published;
+			}
+		}
+	}
+
+	std::atomic<std::shared_ptr<const Version>> Latest;
+};
@@ -1,9 +1,34 @@
 #include "PalleteEditor.h"
 #include "Memory.h"
+#include "Chains.h"
+#include "RemoteViews.h"
 #include "FileLoad.h"
 #include "Auto-Load-Pallete.h"
+#include <thread>
 
 #define GAME_STATUS_MATCH_STARTED 0x4
+#define CHARACTER_SLOT_COUNT 6
+#define ALL_SLOTS ((1 << CHARACTER_SLOT_COUNT) - 1)
+#define MAX_NAME_LENGTH 64
+#define RECONCILE_INTERVAL std::chrono::seconds(1)
+// Poll intervals per state, the fastest right after a change and the slowest
+// once nothing changed for a while
+#define DISCOVERY_POLL_FASTEST std::chrono::milliseconds(1000)
+#define DISCOVERY_POLL_SLOWEST std::chrono::milliseconds(5000)
+#define DETACHED_POLL_FASTEST std::chrono::milliseconds(100)
+#define DETACHED_POLL_SLOWEST std::chrono::milliseconds(1000)
+#define MENU_POLL_FASTEST std::chrono::milliseconds(16)
+#define MENU_POLL_SLOWEST std::chrono::milliseconds(250)
+#define MATCH_POLL_FASTEST std::chrono::milliseconds(16)
+#define MATCH_POLL_SLOWEST std::chrono::milliseconds(100)
+// Longest a watcher sleeps, so a session discovery just added is polled soon
+#define MAX_WATCH_SLEEP std::chrono::milliseconds(50)
+// Threads ticking the sessions, each session stays with one of them
+#define WATCH_WORKERS 2
+// Display toggles as bits, the way the UI queues them
+#define TOGGLE_NODISPLAY_CHAR 0x1
+#define TOGGLE_NODISPLAY_SHADOWS 0x2
+#define TOGGLE_DISPLAY_SUPER_SHADOWS 0x4
 
 namespace PatchStuff {
     std::vector<unsigned char> CodeCave = { //"Skullgirls.exe" + 332EC0
@@ -17,365 +42,1710 @@ namespace PatchStuff {
     };
     std::vector<unsigned char> JmpToCodeCave = { //"Skullgirls.exe" + 18672A
         0xE9, 0x91, 0xC7, 0x1A, 0x00 };
+    // Display toggles and the code they replace in the build AddressTable describes
+    std::vector<unsigned char> NODisplayChar = { 0x90, 0x90 };
+    std::vector<unsigned char> NODisplayCharOriginal = { 0x77, 0x23 };
+    std::vector<unsigned char> NODisplayShadows = { 0xEB, 0x1B };
+    std::vector<unsigned char> NODisplayShadowsOriginal = { 0x75, 0x1E };
+    std::vector<unsigned char> DisplaySuperShadows = { 0x90, 0x90, 0x90, 0x90, 0x90, 0x90 };
+    std::vector<unsigned char> DisplaySuperShadowsOriginal = { 0x0F, 0x8B, 0x22, 0x01, 0x00, 0x00 };
 };
 
 int PalEdit::FindVectorIndexByID(int id) {
-    for (int i = 0; i < PalEdit::Character_Vector.size(); i++) {
-        if (PalEdit::Character_Vector[i].ID == id) {
+    for (int i = 0; i < Character_Vector.size(); i++) {
+        if (Character_Vector[i].ID == id) {
             return i;
         }
     }
     return -1;
 }
 
-void PalEdit::Init() {
-    Sleep(10);
-    s_ProcessId = Memory::FindProcessId(L"Skullgirls.exe");
-    if (s_ProcessId == NULL){
-        bGameOpenned = false;
+PalEdit::PalEdit(DWORD ProcessId) : ProcessId(ProcessId), Poll(DETACHED_POLL_FASTEST, DETACHED_POLL_SLOWEST) {
+}
+
+void PalEdit::Update() {
+    if (s_Workers.empty()) {
+        s_bWatching = true;
+        for (int Worker{ 0 }; Worker < WATCH_WORKERS; Worker++) {
+            s_Workers.emplace_back(WatchSessions, Worker);
+        }
+    }
+    ApplyPendingTable();
+    std::vector<std::shared_ptr<PalEdit>> Live;
+    {
+        std::lock_guard<std::mutex> Lock(s_SessionsLock);
+        s_Sessions.erase(std::remove_if(s_Sessions.begin(), s_Sessions.end(),
+            [](const std::shared_ptr<PalEdit>& Session) { return Session->bEnded.load(); }), s_Sessions.end());
+        Live = s_Sessions;
+    }
+    // The game being edited was closed, go on with the next one
+    if (!s_Active || s_Active->bEnded) {
+        s_Active = Live.empty() ? nullptr : Live.front();
+    }
+    for (const auto& Session : Live) {
+        Session->AdoptFromModel();
+        Session->Adopt();
+        Session->CommitToModel();
+    }
+}
+
+void PalEdit::FlushAll() {
+    for (const auto& Session : Sessions()) {
+        Session->FlushWrites();
+    }
+}
+
+PalEdit& PalEdit::Active() {
+    static PalEdit NoGame;
+    return s_Active ? *s_Active : NoGame;
+}
+
+void PalEdit::Select(const std::shared_ptr<PalEdit>& Session) {
+    s_Active = Session;
+}
+
+std::vector<std::shared_ptr<PalEdit>> PalEdit::Sessions() {
+    std::lock_guard<std::mutex> Lock(s_SessionsLock);
+    return s_Sessions;
+}
+
+void PalEdit::Adopt() {
+    std::shared_ptr<const GameSnapshot> Latest = Snapshot();
+    if (!Latest || Latest == Adopted) {
+        return;
+    }
+    Adopted = Latest;
+    bGameOpenned = Latest->bGameOpenned;
+    bMatchStarted = Latest->bMatchStarted;
+    if (Latest->RosterGeneration != AdoptedGeneration) {
+        AdoptRoster(*Latest);
+        AdoptSlotCache(*Latest);
         return;
     }
-    if (s_ProcessId != NULL) {
-        s_BaseAddress = Memory::GetModuleBaseAddress(s_ProcessId, L"Skullgirls.exe");
-        s_SG_Process = OpenProcess(PROCESS_ALL_ACCESS, TRUE, s_ProcessId);
-        //Patch game;
-        WriteProcessMemory(s_SG_Process, (LPVOID)(s_BaseAddress + 0x332EC0), PatchStuff::CodeCave.data(), PatchStuff::CodeCave.size(), nullptr);
-        WriteProcessMemory(s_SG_Process, (LPVOID)(s_BaseAddress + 0x18672A), PatchStuff::JmpToCodeCave.data(), PatchStuff::JmpToCodeCave.size(), nullptr);
-        bGameOpenned = true;
+    bool bSlots = !std::equal(std::begin(Latest->SlotVersions), std::end(Latest->SlotVersions), std::begin(AdoptedSlotVersions));
+    bool bPalletes = !std::equal(std::begin(Latest->PaletteVersions), std::end(Latest->PaletteVersions), std::begin(AdoptedPaletteVersions));
+    if (bSlots) {
+        AdoptSlots(*Latest);
     }
-    Memory::ReadProcessMemoryWithOffsets(
-        s_SG_Process,
-        s_BaseAddress, {
-        static_cast<uintptr_t>(AddressTable::Base_Adress()),
-        static_cast<uintptr_t>(AddressTable::Offset_GameStatus())  //    
-        },
-        &s_GameStatus);
-
-    if (s_GameStatus != GAME_STATUS_MATCH_STARTED) {
+    if (bPalletes) {
+        AdoptPalletes(*Latest);
+    }
+    AdoptSlotCache(*Latest);
+    if (!bSlots && !bPalletes) {
+        Reconcile(*Latest);
+    }
+}
+
+void PalEdit::MarkUncommitted(int ID) {
+    if (std::find(Uncommitted.begin(), Uncommitted.end(), ID) == Uncommitted.end()) {
+        Uncommitted.push_back(ID);
+    }
+}
+
+void PalEdit::CommitToModel() {
+    if (bRosterUncommitted) {
+        bRosterUncommitted = false;
+        Uncommitted.clear();
+        std::shared_ptr<const PaletteModel::Version> Version = Palettes.Replace(Character_Vector);
+        InModel.clear();
+        for (const Character& Ch : Character_Vector) {
+            InModel[Ch.ID] = Version->Find(Ch.ID);
+        }
+        return;
+    }
+    // Only marked characters that differ from what we published last get a new copy
+    std::vector<Character> Changed;
+    for (int ID : Uncommitted) {
+        int VectorID = FindVectorIndexByID(ID);
+        auto it = InModel.find(ID);
+        if (VectorID != -1 && (it == InModel.end() || !PaletteModel::Same(*it->second, Character_Vector[VectorID]))) {
+            Changed.push_back(Character_Vector[VectorID]);
+        }
+    }
+    Uncommitted.clear();
+    if (Changed.empty()) {
+        return;
+    }
+    std::shared_ptr<const PaletteModel::Version> Version = Palettes.Commit(Changed);
+    for (const Character& Ch : Changed) {
+        InModel[Ch.ID] = Version->Find(Ch.ID);
+    }
+}
+
+void PalEdit::AdoptFromModel() {
+    std::shared_ptr<const PaletteModel::Version> Current = Palettes.Current();
+    if (Current->Number == AdoptedModelVersion) {
+        return;
+    }
+    AdoptedModelVersion = Current->Number;
+    // A character we did not publish ourselves was edited by another thread
+    std::vector<int> IDs;
+    for (const auto& Ch : Current->Characters) {
+        auto it = InModel.find(Ch->ID);
+        int VectorID = FindVectorIndexByID(Ch->ID);
+        if (it == InModel.end() || it->second == Ch || VectorID == -1) {
+            continue;
+        }
+        it->second = Ch;
+        Character_Vector[VectorID] = *Ch;
+        IDs.push_back(Ch->ID);
+    }
+    if (!IDs.empty()) {
+        UpdateCharacters(IDs);
+    }
+}
+
+void PalEdit::StopWatching() {
+    s_bWatching = false;
+    WakeWatchers();
+    for (std::thread& Worker : s_Workers) {
+        Worker.join();
+    }
+    s_Workers.clear();
+    // Leave every game as we found it
+    for (const auto& Session : Sessions()) {
+        std::lock_guard<std::recursive_mutex> Lock(Session->GameLock);
+        // Edits of the last frame still go out
+        Session->ApplyEdits();
+        if (Session->State != AttachState::Detached) {
+            Session->Detach();
+        }
+        Session->WriteQueue.Stop();
+    }
+    std::lock_guard<std::mutex> Lock(s_SessionsLock);
+    s_Sessions.clear();
+    s_Active.reset();
+}
+
+std::shared_ptr<const PalEdit::GameSnapshot> PalEdit::Snapshot() {
+    std::lock_guard<std::mutex> Lock(SnapshotLock);
+    return Published;
+}
+
+// A new roster replaces whatever the UI held, edits not sent yet were for the old one
+void PalEdit::AdoptRoster(const GameSnapshot& Latest) {
+    if (Character_Vector.empty() && (bNODisplayChar || bNODisplayShadows || bDisplaySuperShadows)) {
+        bNODisplayChar = false;
+        bNODisplayShadows = false;
+        bDisplaySuperShadows = false;
+        QueueToggles();
+    }
+    AdoptedGeneration = Latest.RosterGeneration;
+    std::copy(std::begin(Latest.SlotVersions), std::end(Latest.SlotVersions), std::begin(AdoptedSlotVersions));
+    std::copy(std::begin(Latest.PaletteVersions), std::end(Latest.PaletteVersions), std::begin(AdoptedPaletteVersions));
+    Character_Vector = Latest.Roster;
+    bRosterUncommitted = true;
+    Pending.clear();
+    LocalSlots.clear();
+    std::fill(std::begin(AdoptedSlots), std::end(AdoptedSlots), nullptr);
+    Diverged = { 0, 0 };
+    if (FindVectorIndexByID(current_character_idx) == -1) {
+        current_character_idx = -1;
+    }
+    if (!Character_Vector.empty()) {
+        AutoPallete::init(*this);
+    }
+}
+
+// Only some slots were read anew: their characters are replaced and auto-loaded,
+// the others keep their colors, pending edits and the selection
+void PalEdit::AdoptSlots(const GameSnapshot& Latest) {
+    std::vector<int> Changed;
+    for (int n{ 0 }; n < CHARACTER_SLOT_COUNT; n++) {
+        if (Latest.SlotVersions[n] != AdoptedSlotVersions[n]) {
+            AdoptedSlotVersions[n] = Latest.SlotVersions[n];
+            Changed.push_back(n);
+        }
+    }
+    for (int ID : Changed) {
+        int VectorID = FindVectorIndexByID(ID);
+        if (VectorID != -1) {
+            Character_Vector.erase(Character_Vector.begin() + VectorID);
+        }
+        Pending.erase(ID);
+        bRosterUncommitted = true;
+        for (const Character& Ch : Latest.Roster) {
+            if (Ch.ID != ID) {
+                continue;
+            }
+            // Slot order, like the roster
+            auto Next = std::find_if(Character_Vector.begin(), Character_Vector.end(),
+                [ID](const Character& Other) { return Other.ID > ID; });
+            Character_Vector.insert(Next, Ch);
+        }
+    }
+    if (FindVectorIndexByID(current_character_idx) == -1) {
         current_character_idx = -1;
-        Character_Vector.clear();
-        bMatchStarted = false;
+    }
+    AutoPallete::init(*this, Changed);
+}
+
+// The game switched or rewrote the palette of some characters. They take the
+// game's palette, edits of them not sent yet are dropped. The selection, the
+// other characters and their pending edits stay.
+void PalEdit::AdoptPalletes(const GameSnapshot& Latest) {
+    for (const Character& Game : Latest.Roster) {
+        if (Latest.PaletteVersions[Game.ID] == AdoptedPaletteVersions[Game.ID]) {
+            continue;
+        }
+        AdoptedPaletteVersions[Game.ID] = Latest.PaletteVersions[Game.ID];
+        int VectorID = FindVectorIndexByID(Game.ID);
+        if (VectorID == -1) {
+            continue;
+        }
+        Character& Local = Character_Vector[VectorID];
+        Local.Current_Pallete_Num = Game.Current_Pallete_Num;
+        Local.Character_Colors = Game.Character_Colors;
+        Local.LineColor = Game.LineColor;
+        Local.SuperShadowColor1 = Game.SuperShadowColor1;
+        Local.SuperShadowColor2 = Game.SuperShadowColor2;
+        Pending.erase(Game.ID);
+        MarkUncommitted(Game.ID);
+        auto Slots = LocalSlots.find(Game.ID);
+        if (Slots != LocalSlots.end()) {
+            Slots->second.Store(Local);
+        }
+    }
+}
+
+// Slots the watcher read anew replace the UI's. The palette on screen keeps the
+// UI's values, edits of it may not have reached the game when it was read.
+void PalEdit::AdoptSlotCache(const GameSnapshot& Latest) {
+    for (int n{ 0 }; n < CHARACTER_SLOT_COUNT; n++) {
+        if (Latest.Slots[n] == AdoptedSlots[n]) {
+            continue;
+        }
+        AdoptedSlots[n] = Latest.Slots[n];
+        if (!Latest.Slots[n]) {
+            LocalSlots.erase(n);
+            continue;
+        }
+        PalleteSlots& Slots = LocalSlots[n] = *Latest.Slots[n];
+        int VectorID = FindVectorIndexByID(n);
+        if (VectorID != -1) {
+            Slots.Store(Character_Vector[VectorID]);
+        }
+    }
+}
+
+void PalEdit::WatchSessions(int Worker) {
+    // Looking for games takes a process snapshot, only the first worker does it
+    PollScheduler Discovery(DISCOVERY_POLL_FASTEST, DISCOVERY_POLL_SLOWEST);
+    std::vector<std::shared_ptr<PalEdit>> Mine;
+    while (s_bWatching) {
+        uint64_t Woken;
+        {
+            std::lock_guard<std::mutex> Lock(s_WakeLock);
+            Woken = s_WakeCount;
+        }
+        auto Now = PollScheduler::Clock::now();
+        auto Wake = Now + MAX_WATCH_SLEEP;
+        if (Worker == 0) {
+            if (Discovery.Due(Now)) {
+                if (Discovery.Polled(Now, Discover(), { 0, 0 })) {
+                    s_DiscoveryIntervalMs = Discovery.LastLoad().IntervalMs;
+                }
+            }
+            Wake = (std::min)(Wake, Discovery.NextPoll());
+        }
+        Mine.clear();
+        {
+            std::lock_guard<std::mutex> Lock(s_SessionsLock);
+            for (const auto& Session : s_Sessions) {
+                if (Session->Worker == Worker && !Session->bEnded) {
+                    Mine.push_back(Session);
+                }
+            }
+        }
+        {
+            std::shared_lock<std::shared_mutex> Table(s_TableLock);
+            for (const auto& Session : Mine) {
+                std::lock_guard<std::recursive_mutex> Lock(Session->GameLock);
+                if (Session->bTableChanged.exchange(false) && Session->State != AttachState::Detached) {
+                    Session->Release();
+                    Session->SetPollBounds();
+                    Session->Publish();
+                }
+                Session->ApplyEdits();
+                Wake = (std::min)(Wake, Session->Tick());
+            }
+        }
+        std::unique_lock<std::mutex> Lock(s_WakeLock);
+        s_Wake.wait_until(Lock, Wake, [Woken] { return s_WakeCount != Woken || !s_bWatching; });
+    }
+}
+
+void PalEdit::LoadTable(const char* Path) {
+    s_PendingTable = Path;
+    ApplyPendingTable();
+}
+
+void PalEdit::ApplyPendingTable() {
+    if (s_PendingTable.empty()) {
         return;
     }
-    bMatchStarted = true;
+    std::unique_lock<std::shared_mutex> Lock(s_TableLock, std::try_to_lock);
+    if (!Lock.owns_lock()) {
+        return;
+    }
+    bool bLoaded = AddressTable::LoadFromFile(s_PendingTable.c_str());
+    s_PendingTable.clear();
+    if (!bLoaded) {
+        return;
+    }
+    // Flagged before any watcher ticks with the new table
+    for (const auto& Session : Sessions()) {
+        Session->bTableChanged = true;
+    }
+    Lock.unlock();
+    WakeWatchers();
+}
 
-    if (bGameOpenned and bMatchStarted and Character_Vector.size() != 0) {
+void PalEdit::WakeWatchers() {
+    {
+        std::lock_guard<std::mutex> Lock(s_WakeLock);
+        s_WakeCount++;
+    }
+    s_Wake.notify_all();
+}
+
+// A new session for every game without one, the ones whose game is gone end on their next tick
+bool PalEdit::Discover() {
+    std::vector<DWORD> Running = Memory::FindProcessIds(L"Skullgirls.exe");
+    bool bChanged = false;
+    std::lock_guard<std::mutex> Lock(s_SessionsLock);
+    for (const auto& Session : s_Sessions) {
+        if (std::find(Running.begin(), Running.end(), Session->ProcessId) == Running.end()) {
+            bChanged |= !Session->bProcessGone.exchange(true);
+        }
+    }
+    for (DWORD Id : Running) {
+        bool bKnown = std::any_of(s_Sessions.begin(), s_Sessions.end(),
+            [Id](const std::shared_ptr<PalEdit>& Session) { return Session->ProcessId == Id && !Session->bEnded; });
+        if (bKnown) {
+            continue;
+        }
+        auto Session = std::make_shared<PalEdit>(Id);
+        Session->Worker = s_NextWorker++ % WATCH_WORKERS;
+        Session->WriteQueue.Start();
+        s_Sessions.push_back(std::move(Session));
+        bChanged = true;
+    }
+    return bChanged;
+}
+
+void PalEdit::Publish() {
+    auto Next = std::make_shared<GameSnapshot>();
+    Next->bGameOpenned = State != AttachState::Detached;
+    Next->bMatchStarted = State == AttachState::InMatch;
+    Next->RosterGeneration = RosterGeneration;
+    std::copy(std::begin(SlotVersions), std::end(SlotVersions), std::begin(Next->SlotVersions));
+    std::copy(std::begin(PaletteVersions), std::end(PaletteVersions), std::begin(Next->PaletteVersions));
+    Next->Roster = Roster;
+    std::copy(std::begin(PublishedSlots), std::end(PublishedSlots), std::begin(Next->Slots));
+    Next->WriteCount = SentBeforeRead;
+    Next->ChainReads = Cache.ReadsDoneLastFrame();
+    Next->ChainReadsSaved = Cache.ReadsSavedLastFrame();
+    Next->MirroredPages = Mirror.PageCount();
+
+    std::lock_guard<std::mutex> Lock(SnapshotLock);
+    Published = std::move(Next);
+}
+
+PollScheduler::Clock::time_point PalEdit::Tick() {
+    auto Now = PollScheduler::Clock::now();
+    if (!Poll.Due(Now)) {
+        return Poll.NextPoll();
+    }
+    Cache.BeginFrame();
+    Memory::ReadCost Before = Memory::ThreadReadCost();
+    AttachState Was = State;
+    bool bChanged = false;
+
+    switch (State) {
+    case AttachState::Detached:
+        if (bProcessGone) {
+            bEnded = true;
+        }
+        else {
+            Attach();
+        }
+        break;
+    case AttachState::Attached:
+        if (!Memory::IsProcessAlive(SG_Process)) {
+            Detach();
+            break;
+        }
+        {
+            // Menus and character select change the status, a menu left alone does not
+            int Previous = GameStatus;
+            if (ReadGameStatus() == GAME_STATUS_MATCH_STARTED) {
+                EnterMatch();
+            }
+            bChanged = GameStatus != Previous;
+        }
+        break;
+    case AttachState::InMatch:
+        if (!Memory::IsProcessAlive(SG_Process)) {
+            Detach();
+            break;
+        }
+        bChanged = UpdateMatch();
+        break;
+    }
+
+    if (State != Was) {
+        SetPollBounds();
+        bChanged = true;
+    }
+    Memory::ReadCost After = Memory::ThreadReadCost();
+    if (Poll.Polled(Now, bChanged, { After.Calls - Before.Calls, After.Bytes - Before.Bytes })) {
+        std::lock_guard<std::mutex> Lock(SnapshotLock);
+        PollLoad = Poll.LastLoad();
+    }
+    return Poll.NextPoll();
+}
+
+void PalEdit::SetPollBounds() {
+    switch (State) {
+    case AttachState::Detached:
+        Poll.SetBounds(DETACHED_POLL_FASTEST, DETACHED_POLL_SLOWEST);
+        break;
+    case AttachState::Attached:
+        Poll.SetBounds(MENU_POLL_FASTEST, MENU_POLL_SLOWEST);
+        break;
+    case AttachState::InMatch:
+        Poll.SetBounds(MATCH_POLL_FASTEST, MATCH_POLL_SLOWEST);
+        break;
+    }
+}
+
+PollScheduler::Load PalEdit::Polling() {
+    std::lock_guard<std::mutex> Lock(SnapshotLock);
+    return PollLoad;
+}
+
+bool PalEdit::Attach() {
+    // The module is not mapped yet right after the game starts, try again later
+    BaseAddress = Memory::GetModuleBaseAddress(ProcessId, L"Skullgirls.exe");
+    if (BaseAddress == 0) {
+        return false;
+    }
+    SG_Process = Memory::OpenProcessHandle(ProcessId);
+    if (!SG_Process) {
+        return false;
+    }
+    //Patch game; the display toggles start out removed
+    AddPatches();
+    Patches.Sync(SG_Process);
+    // Edits go out as a new frame starts if the table says where the game counts them
+    WriteQueue.SyncToFrames(AddressTable::NEW_Base_Adress_FrameCounter() != 0
+        ? BaseAddress + Chains::FrameCounter()[0] : 0);
+
+    Cache.Invalidate();
+    Mirror.Clear();
+    State = AttachState::Attached;
+    Publish();
+    return true;
+}
+
+void PalEdit::Detach() {
+    Release();
+    // A process does not come back, a restarted game gets a session of its own
+    bEnded = true;
+    Publish();
+}
+
+void PalEdit::Release() {
+    LeaveMatch();
+    // Edits still on their way go out through the handle we are about to close
+    WriteQueue.Drain();
+    WriteQueue.SyncToFrames(0);
+    // Fails quietly if the game is already gone
+    Patches.RestoreAll(SG_Process);
+    Patches.Clear();
+    NODisplayCharPatch = -1;
+    NODisplayShadowsPatch = -1;
+    DisplaySuperShadowsPatch = -1;
+    Memory::CloseProcessHandle(SG_Process);
+    SG_Process = {};
+    State = AttachState::Detached;
+}
+
+void PalEdit::AddPatches() {
+    Patches.Clear();
+    // The cave goes in before the jump to it
+    Patches.Want(Patches.Add(BaseAddress + 0x332EC0, PatchStuff::CodeCave), true);
+    Patches.Want(Patches.Add(BaseAddress + 0x18672A, PatchStuff::JmpToCodeCave), true);
+    NODisplayCharPatch = Patches.Add(
+        BaseAddress + Chains::DonotdisplayCharCode()[0],
+        PatchStuff::NODisplayChar, PatchStuff::NODisplayCharOriginal);
+    NODisplayShadowsPatch = Patches.Add(
+        BaseAddress + Chains::DonotdisplayShadowsCode()[0],
+        PatchStuff::NODisplayShadows, PatchStuff::NODisplayShadowsOriginal);
+    DisplaySuperShadowsPatch = Patches.Add(
+        BaseAddress + Chains::DisplaySuperShadowCode()[0],
+        PatchStuff::DisplaySuperShadows, PatchStuff::DisplaySuperShadowsOriginal);
+}
+
+void PalEdit::EnterMatch() {
+    Cache.Invalidate();
+    Mirror.Clear();
+    State = AttachState::InMatch;
+    RebuildRoster();
+}
+
+void PalEdit::LeaveMatch() {
+    Roster.clear();
+    RosterGeneration++;
+    Shadows.clear();
+    SlotCache.clear();
+    std::fill(std::begin(PublishedSlots), std::end(PublishedSlots), nullptr);
+    WrittenSpans.clear();
+    Cache.Invalidate();
+    Mirror.Clear();
+    for (int n{ 0 }; n < CHARACTER_SLOT_COUNT; n++) {
+        ForgetTracked(n);
+    }
+    bRetrack = false;
+    if (State == AttachState::InMatch) {
+        State = AttachState::Attached;
+    }
+    Publish();
+}
+
+bool PalEdit::UpdateMatch() {
+    if (Roster.empty()) {
+        // Characters may still be loading, look again on the next poll
+        if (ReadGameStatus() != GAME_STATUS_MATCH_STARTED) {
+            LeaveMatch();
+            return true;
+        }
+        RebuildRoster();
+        return true;
+    }
+
+    // The one read per poll, everything else in the frame is served from the mirror
+    SentBeforeRead = WriteQueue.Sent();
+    if (bRetrack) {
+        RetrackMirror();
+    }
+    Mirror.Refresh(SG_Process);
+    int Moved = ForgetMovedSlots();
+    if (Moved != 0 || !Mirror.Read(RootGeneration + AddressTable::Offset_GameStatus(), &GameStatus)) {
+        GameStatus = ReadGameStatus();
+    }
+    if (GameStatus != GAME_STATUS_MATCH_STARTED) {
+        LeaveMatch();
+        return true;
+    }
+    if (Moved != 0) {
+        // Read only the slots that moved, the others keep their cached chains and colors
+        RebuildSlots(Moved);
+        return true;
+    }
+    int Switched = SamplePalletes();
+    if (Switched != 0) {
+        RereadPalletes(Switched);
+        return true;
+    }
+    VerifyWrites();
+    if (std::chrono::steady_clock::now() - LastReconcile >= RECONCILE_INTERVAL) {
+        RefreshRoster();
+    }
+    return false;
+}
+
+// Hashes the current palette of every slot as the refreshed mirror holds it, no
+// reads. Only a changed hash is looked at in detail: values the shadow holds are
+// our own writes arriving, anything else was changed by the game.
+int PalEdit::SamplePalletes() {
+    // The mirror may not hold our latest writes yet, they would look like changes
+    if (SentBeforeRead != WriteQueue.Queued()) {
+        return 0;
+    }
+    int Switched = 0;
+    for (const Character& Ch : Roster) {
+        Character Game = Ch;
+        if (!Mirror.Read(SlotGenerations[Ch.ID].CharacterPointer + AddressTable::Offset_CurrentPalette(), &Game.Current_Pallete_Num)) {
+            continue;
+        }
+        Memory::Chain<5> LineColorChain = Chains::LineColor(Ch.ID, Game.Current_Pallete_Num);
+        Memory::Chain<6> SuperShadowChain = Chains::SuperShadow(Ch.ID, Game.Current_Pallete_Num);
+        Memory::Chain<6> ColorChain = Chains::PaletteColors(Ch.ID, Game.Current_Pallete_Num);
+        Memory::ChainCache::BatchEntry Entries[] = {
+            Memory::ChainCache::Entry(LineColorChain),
+            Memory::ChainCache::Entry(SuperShadowChain),
+            Memory::ChainCache::Entry(ColorChain)
+        };
+        Cache.ResolveBatch(SG_Process, BaseAddress, Entries, 3);
+        if (!Entries[0].bResolved || !Entries[1].bResolved || !Entries[2].bResolved) {
+            continue;
+        }
+        // Line color, both super shadows and the colors, in one block to hash
+        std::vector<__int32> Values(3 + (std::max)(Ch.Num_Of_Color, 0));
+        size_t ColorsSize = (Values.size() - 3) * sizeof(__int32);
+        if (!Mirror.Read(Entries[0].Address, &Values[0], sizeof(__int32)) ||
+            !Mirror.Read(Entries[1].Address, &Values[1], 2 * sizeof(__int32)) ||
+            !Mirror.Read(Entries[2].Address, Values.data() + 3, ColorsSize)) {
+            // A palette the mirror does not hold yet, it comes in with the next refresh
+            TrackPallete(Ch.ID, Game.Current_Pallete_Num, Entries[0].Address, sizeof(__int32));
+            TrackPallete(Ch.ID, Game.Current_Pallete_Num, Entries[1].Address, 2 * sizeof(__int32));
+            TrackPallete(Ch.ID, Game.Current_Pallete_Num, Entries[2].Address, ColorsSize);
+            continue;
+        }
+        uint64_t Hash = Memory::Hash(Values.data(), Values.size() * sizeof(__int32));
+
+        PaletteSample& Sample = Samples[Ch.ID];
+        if (Sample.bValid && Sample.Pallete_Num == Game.Current_Pallete_Num && Sample.Hash == Hash) {
+            continue;
+        }
+        bool bFirst = !Sample.bValid;
+        Sample = { true, Game.Current_Pallete_Num, Hash };
+        if (bFirst) {
+            continue;
+        }
+        const Character* Shadow = FindShadow(Ch.ID, Game.Current_Pallete_Num);
+        if (Shadow && Shadow->LineColor == Values[0] &&
+            Shadow->SuperShadowColor1 == Values[1] && Shadow->SuperShadowColor2 == Values[2] &&
+            std::equal(Shadow->Character_Colors.begin(), Shadow->Character_Colors.end(), Values.begin() + 3, Values.end())) {
+            continue;
+        }
+        Switched |= 1 << Ch.ID;
+    }
+    return Switched;
+}
+
+// Takes the current palette of these slots from the game into the roster and the
+// shadow, and publishes it for the UI
+void PalEdit::RereadPalletes(int Slots) {
+    for (Character& Ch : Roster) {
+        if ((Slots & (1 << Ch.ID)) == 0) {
+            continue;
+        }
+        Mirror.Read(SlotGenerations[Ch.ID].CharacterPointer + AddressTable::Offset_CurrentPalette(), &Ch.Current_Pallete_Num);
+        ReadPalletes(&Ch, 1);
+        PaletteVersions[Ch.ID]++;
+        // The game's palette wins, our writes to it are not sent again
+        ForgetWritten(Ch.ID);
+        // The palette read may have brought in new pages, sample it again from there
+        Samples[Ch.ID].bValid = false;
+    }
+    Publish();
+}
+
+void PalEdit::RebuildRoster() {
+    SentBeforeRead = WriteQueue.Sent();
+    Roster.clear();
+    RosterGeneration++;
+    Shadows.clear();
+    SlotCache.clear();
+    std::fill(std::begin(PublishedSlots), std::end(PublishedSlots), nullptr);
+    WrittenSpans.clear();
+    Mirror.Clear();
+    for (int n{ 0 }; n < CHARACTER_SLOT_COUNT; n++) {
+        ForgetTracked(n);
+    }
+    bRetrack = false;
+    std::fill(std::begin(Samples), std::end(Samples), PaletteSample{});
+    Cache.SetMirror(&Mirror);
+    ReadRoster(ALL_SLOTS);
+    Publish();
+}
+
+void PalEdit::RebuildSlots(int Slots) {
+    SentBeforeRead = WriteQueue.Sent();
+    for (int n{ 0 }; n < CHARACTER_SLOT_COUNT; n++) {
+        if (Slots & (1 << n)) {
+            SlotVersions[n]++;
+            Shadows.erase(n);
+            SlotCache.erase(n);
+            PublishedSlots[n].reset();
+            ForgetTracked(n);
+            ForgetWritten(n);
+            Samples[n] = {};
+        }
+    }
+    Roster.erase(std::remove_if(Roster.begin(), Roster.end(),
+        [Slots](const Character& Ch) { return (Slots & (1 << Ch.ID)) != 0; }), Roster.end());
+    // Drop the pages of the old buffers, the kept slots go on as they were
+    RetrackMirror();
+    ReadRoster(Slots);
+    std::sort(Roster.begin(), Roster.end(), [](const Character& a, const Character& b) { return a.ID < b.ID; });
+    Publish();
+}
+
+void PalEdit::TrackSlot(int Slot, uintptr_t Address, size_t Size) {
+    size_t& Tracked = SlotRanges[Slot][Address];
+    Tracked = (std::max)(Tracked, Size);
+    Mirror.Track(Address, Size);
+}
+
+void PalEdit::TrackPallete(int Slot, int Pallete_Num, uintptr_t Address, size_t Size) {
+    if (TrackedPallete[Slot] != Pallete_Num) {
+        // The palette the slot left stays mirrored until the next refresh
+        bRetrack |= !PalleteRanges[Slot].empty();
+        PalleteRanges[Slot].clear();
+        TrackedPallete[Slot] = Pallete_Num;
+    }
+    size_t& Tracked = PalleteRanges[Slot][Address];
+    Tracked = (std::max)(Tracked, Size);
+    Mirror.Track(Address, Size);
+}
+
+void PalEdit::ForgetTracked(int Slot) {
+    SlotRanges[Slot].clear();
+    PalleteRanges[Slot].clear();
+    TrackedPallete[Slot] = -1;
+}
+
+void PalEdit::RetrackMirror() {
+    bRetrack = false;
+    Mirror.Clear();
+    if (RootGeneration != 0) {
+        Mirror.Track(BaseAddress + AddressTable::Base_Adress(), sizeof(Memory::RemotePointer));
+        Mirror.Track(RootGeneration + AddressTable::Offset_Character(), CHARACTER_SLOT_COUNT * sizeof(Memory::RemotePointer));
+        Mirror.Track(RootGeneration + AddressTable::Offset_GameStatus(), sizeof(GameStatus));
+    }
+    for (int n{ 0 }; n < CHARACTER_SLOT_COUNT; n++) {
+        for (const auto& [Address, Size] : SlotRanges[n]) {
+            Mirror.Track(Address, Size);
+        }
+        for (const auto& [Address, Size] : PalleteRanges[n]) {
+            Mirror.Track(Address, Size);
+        }
+    }
+}
+
+int PalEdit::ReadGameStatus() {
+    GameStatus = 0;
+    Memory::ReadProcessMemoryWithOffsets(
+        SG_Process,
+        BaseAddress,
+        Chains::GameStatus(),
+        &GameStatus);
+    return GameStatus;
+}
+
+// Compares the first-level pointers in the freshly refreshed mirror with the ones
+// the roster was read through. Returns the slots that moved, as bits.
+int PalEdit::ForgetMovedSlots() {
+    Memory::RemotePointer Root = 0;
+    Memory::RemotePointer SlotPointers[CHARACTER_SLOT_COUNT] = {};
+    if (!Mirror.Read(BaseAddress + AddressTable::Base_Adress(), &Root) || Root != RootGeneration ||
+        !Mirror.Read(Root + AddressTable::Offset_Character(), SlotPointers, sizeof(SlotPointers))) {
+        // Every chain goes through the root pointer
+        Cache.Invalidate();
+        return ALL_SLOTS;
+    }
+
+    int Moved = 0;
+    for (int n{ 0 }; n < CHARACTER_SLOT_COUNT; n++) {
+        Memory::RemotePointer PaletteData = 0;
+        if (SlotPointers[n] != 0) {
+            Mirror.Read(SlotPointers[n] + AddressTable::Offset_PaletteData(), &PaletteData);
+        }
+        if (SlotPointers[n] != SlotGenerations[n].CharacterPointer || PaletteData != SlotGenerations[n].PaletteDataPointer) {
+            Cache.Forget(BaseAddress, Chains::CharacterHops(n));
+            Moved |= 1 << n;
+        }
+    }
+    return Moved;
+}
+
+void PalEdit::ReadRoster(int Slots) {
+    // The six character pointers sit next to each other in one table
+    uintptr_t SlotTable = 0;
+    Memory::RemotePointer SlotPointers[CHARACTER_SLOT_COUNT] = {};
+    if (!Cache.Resolve(SG_Process, BaseAddress, Chains::SlotTable(), &SlotTable) ||
+        !Memory::Read(SG_Process, SlotTable, SlotPointers, sizeof(SlotPointers))) {
         return;
     }
+    // Watch the first-level pointers through the mirror from now on
+    RootGeneration = SlotTable - AddressTable::Offset_Character();
+    Mirror.Track(BaseAddress + AddressTable::Base_Adress(), sizeof(Memory::RemotePointer));
+    Mirror.Track(SlotTable, sizeof(SlotPointers));
+    Mirror.Track(RootGeneration + AddressTable::Offset_GameStatus(), sizeof(GameStatus));
+    for (int n{ 0 }; n < CHARACTER_SLOT_COUNT; n++) {
+        if ((Slots & (1 << n)) == 0) {
+            continue;
+        }
+        SlotGenerations[n] = { SlotPointers[n], 0 };
+        if (SlotPointers[n] != 0) {
+            TrackSlot(n, SlotPointers[n] + AddressTable::Offset_PaletteData(), sizeof(Memory::RemotePointer));
+            TrackSlot(n, SlotPointers[n] + AddressTable::Offset_CurrentPalette(), sizeof(int));
+        }
+    }
 
-    bNODisplayChar = false;
-    bNODisplayShadows = false;
-    bDisplaySuperShadows = false;
-
-    Character_Vector.clear();
-    for (int n{ 0 }; n < 6; n++) {
-        std::string Name;
-        Memory::ReadProcessMemoryWithOffsets(
-            s_SG_Process,
-            s_BaseAddress, {
-            static_cast<uintptr_t>(AddressTable::Base_Adress()),
-            static_cast<uintptr_t>(AddressTable::Offset_Character() + n * 4),  //    
-            static_cast<uintptr_t>(AddressTable::Offset_Name()) },
-            &Name
-            );
-        if (Name != "") {
-            Character Ch;
-            Ch.Char_Name = Name;
-            Ch.ID = n;
-            Memory::ReadProcessMemoryWithOffsets(
-                s_SG_Process,
-                s_BaseAddress, {
-                static_cast<uintptr_t>(AddressTable::Base_Adress()),
-                static_cast<uintptr_t>(AddressTable::Offset_Character() + n * 4),  //    
-                static_cast<uintptr_t>(AddressTable::Offset_PaletteData()),
-                static_cast<uintptr_t>(AddressTable::Offset_PaletteTotalOffset()),
-                },
-                &Ch.Max_Pallete_Num
-                );
-            Memory::ReadProcessMemoryWithOffsets(
-                s_SG_Process,
-                s_BaseAddress, {
-                static_cast<uintptr_t>(AddressTable::Base_Adress()),
-                static_cast<uintptr_t>(AddressTable::Offset_Character() + n * 4),  //    
-                static_cast<uintptr_t>(AddressTable::Offset_CurrentPalette()),
-                },
-                &Ch.Current_Pallete_Num
-                );
-            Memory::ReadProcessMemoryWithOffsets(
-                s_SG_Process,
-                s_BaseAddress, {
-                static_cast<uintptr_t>(AddressTable::Base_Adress()),
-                static_cast<uintptr_t>(AddressTable::Offset_Character() + n * 4),  //    
-                static_cast<uintptr_t>(AddressTable::Offset_PaletteData()),
-                static_cast<uintptr_t>(AddressTable::Offset_NumberOfColor()),
-                },
-                &Ch.Num_Of_Color
-                );
-            Memory::ReadProcessMemoryWithOffsets(
-                s_SG_Process,
-                s_BaseAddress, {
-                static_cast<uintptr_t>(AddressTable::Base_Adress()),
-                static_cast<uintptr_t>(AddressTable::Offset_Character() + n * 4),  //    
-                static_cast<uintptr_t>(AddressTable::Offset_PaletteData()),
-                static_cast<uintptr_t>(AddressTable::NEW_Offset_LineColor()),
-                static_cast<uintptr_t>(4 * Ch.Current_Pallete_Num),
-                },
-                &Ch.LineColor
-                );
-            //SuperShadows1
-            Memory::ReadProcessMemoryWithOffsets(
-                s_SG_Process,
-                s_BaseAddress, {
-                static_cast<uintptr_t>(AddressTable::Base_Adress()),
-                static_cast<uintptr_t>(AddressTable::Offset_Character() + n * 4),  //    
-                static_cast<uintptr_t>(AddressTable::Offset_PaletteData()),
-                static_cast<uintptr_t>(AddressTable::NEW_Offset_SuperShadow()),
-                static_cast<uintptr_t>(4 * Ch.Current_Pallete_Num),
-                0
-                },
-                &Ch.SuperShadowColor1
-            );
-            Memory::ReadProcessMemoryWithOffsets(
-                s_SG_Process,
-                s_BaseAddress, {
-                static_cast<uintptr_t>(AddressTable::Base_Adress()),
-                static_cast<uintptr_t>(AddressTable::Offset_Character() + n * 4),  //    
-                static_cast<uintptr_t>(AddressTable::Offset_PaletteData()),
-                static_cast<uintptr_t>(AddressTable::NEW_Offset_SuperShadow()),
-                static_cast<uintptr_t>(4 * Ch.Current_Pallete_Num),
-                4
-                },
-                &Ch.SuperShadowColor2
-            );
-            Character_Vector.push_back(Ch);
-            std::cout << Name;
-        }
-    }
-
-    AutoPallete::init();
+    // Every character struct with one scatter read
+    std::vector<CharacterView> CharacterViews;
+    std::vector<int> ViewSlots;
+    std::vector<Memory::Span> Spans;
+    for (int n{ 0 }; n < CHARACTER_SLOT_COUNT; n++) {
+        if ((Slots & (1 << n)) != 0 && SlotPointers[n] != 0) {
+            CharacterViews.emplace_back(SlotPointers[n]);
+            ViewSlots.push_back(n);
+        }
+    }
+    for (CharacterView& View : CharacterViews) {
+        Spans.push_back(View.Span());
+    }
+    std::vector<bool> bRead;
+    Memory::ReadEach(SG_Process, Spans.data(), Spans.size(), &bRead);
+
+    std::vector<Character> Found;
+    std::vector<PaletteDataView> DataViews;
+    for (size_t i = 0; i < CharacterViews.size(); i++) {
+        const CharacterView& View = CharacterViews[i];
+        if (!bRead[i]) {
+            continue;
+        }
+        SlotGenerations[ViewSlots[i]].PaletteDataPointer = View.PaletteData();
+        Character Ch;
+        Ch.ID = ViewSlots[i];
+        if (!View.Name(&Ch.Char_Name)) {
+            Cache.ReadString(SG_Process, View.NameAddress(), MAX_NAME_LENGTH, &Ch.Char_Name);
+        }
+        if (Ch.Char_Name == "") {
+            continue;
+        }
+        Ch.Current_Pallete_Num = View.CurrentPalette();
+        Ch.Max_Pallete_Num = 0;
+        Ch.Num_Of_Color = 0;
+        Cache.Remember(BaseAddress, Chains::CharacterHops(Ch.ID), View.Address);
+        Cache.Remember(BaseAddress, Chains::PaletteDataHops(Ch.ID), View.PaletteData());
+        Found.push_back(Ch);
+        DataViews.emplace_back(View.PaletteData());
+    }
+
+    // Every palette data struct with one more
+    Spans.clear();
+    for (PaletteDataView& View : DataViews) {
+        Spans.push_back(View.Span());
+    }
+    Memory::ReadEach(SG_Process, Spans.data(), Spans.size(), &bRead);
+    for (size_t i = 0; i < Found.size(); i++) {
+        Character& Ch = Found[i];
+        const PaletteDataView& View = DataViews[i];
+        if (bRead[i]) {
+            Ch.Max_Pallete_Num = View.Total();
+            Ch.Num_Of_Color = View.NumberOfColors();
+            Cache.Remember(BaseAddress, Chains::ColorPointersHops(Ch.ID), View.ColorPointers());
+            Cache.Remember(BaseAddress, Chains::SuperShadowPointersHops(Ch.ID), View.SuperShadowPointers());
+            Cache.Remember(BaseAddress, Chains::LineColorsHops(Ch.ID), View.LineColors());
+            // Per-palette tables, so a palette switch resolves from the mirror
+            size_t TableSize = (std::max)(Ch.Max_Pallete_Num, 0) * sizeof(Memory::RemotePointer);
+            TrackSlot(Ch.ID, View.ColorPointers(), TableSize);
+            TrackSlot(Ch.ID, View.SuperShadowPointers(), TableSize);
+            TrackSlot(Ch.ID, View.LineColors(), TableSize);
+        }
+    }
+    ReadPalletes(Found.data(), Found.size());
+    Roster.insert(Roster.end(), Found.begin(), Found.end());
 }
 
 void PalEdit::Read_Character() {
-    int VectorID = FindVectorIndexByID(current_character_idx);
-    //LineColor
-    Memory::ReadProcessMemoryWithOffsets(
-        s_SG_Process,
-        s_BaseAddress, {
-        static_cast<uintptr_t>(AddressTable::Base_Adress()),
-        static_cast<uintptr_t>(AddressTable::Offset_Character() + current_character_idx * 4),  //    
-        static_cast<uintptr_t>(AddressTable::Offset_PaletteData()),
-        static_cast<uintptr_t>(AddressTable::NEW_Offset_LineColor()),
-        static_cast<uintptr_t>(4 * Character_Vector[VectorID].Current_Pallete_Num),
-        },
-        &Character_Vector[VectorID].LineColor
-        );
-    //SuperShadows1
-    Memory::ReadProcessMemoryWithOffsets(
-        s_SG_Process,
-        s_BaseAddress, {
-        static_cast<uintptr_t>(AddressTable::Base_Adress()),
-        static_cast<uintptr_t>(AddressTable::Offset_Character() + current_character_idx * 4),  //    
-        static_cast<uintptr_t>(AddressTable::Offset_PaletteData()),
-        static_cast<uintptr_t>(AddressTable::NEW_Offset_SuperShadow()),
-        static_cast<uintptr_t>(4 * Character_Vector[VectorID].Current_Pallete_Num),
-        0
-        },
-        &Character_Vector[VectorID].SuperShadowColor1
-    );
-    Memory::ReadProcessMemoryWithOffsets(
-        s_SG_Process,
-        s_BaseAddress, {
-        static_cast<uintptr_t>(AddressTable::Base_Adress()),
-        static_cast<uintptr_t>(AddressTable::Offset_Character() + current_character_idx * 4),  //    
-        static_cast<uintptr_t>(AddressTable::Offset_PaletteData()),
-        static_cast<uintptr_t>(AddressTable::NEW_Offset_SuperShadow()),
-        static_cast<uintptr_t>(4 * Character_Vector[VectorID].Current_Pallete_Num),
-        4
-        },
-        &Character_Vector[VectorID].SuperShadowColor2
-    );
-    //Colors
-        Character_Vector[VectorID].Character_Colors.clear();
-        for (int bar{ 0 }; bar < Character_Vector[VectorID].Num_Of_Color; bar++) {
-            __int32 color;
-            Memory::ReadProcessMemoryWithOffsets(
-                s_SG_Process,
-                s_BaseAddress, {
-                static_cast<uintptr_t>(AddressTable::Base_Adress()),
-                static_cast<uintptr_t>(AddressTable::Offset_Character() + Character_Vector[VectorID].ID * 4),  //    
-                static_cast<uintptr_t>(AddressTable::Offset_PaletteData()),
-                static_cast<uintptr_t>(AddressTable::Offset_ColorCodeOffset()),
-                static_cast<uintptr_t>(4 * Character_Vector[VectorID].Current_Pallete_Num),
-                static_cast<uintptr_t>(4 * bar),
-                },
-                &color
-                );
-            Character_Vector[VectorID].Character_Colors.push_back(color);
+    // Character_Vector follows the game through the snapshots already. The other
+    // slots are read too, so the palette slider and slot copies stay local.
+    Queue(QueuedEdit::Kind::ReadSlots, current_character_idx, 0);
+}
+
+void PalEdit::ReadPalletes(Character* Chars, size_t Count) {
+    // Find where line color, super shadows and colors of every character live
+    // (mostly from the chain cache), then take them from the mirror
+    struct PalleteChains {
+        Memory::Chain<5> LineColor;
+        Memory::Chain<6> SuperShadow;
+        Memory::Chain<6> Colors;
+    };
+    std::vector<PalleteChains> ChainsOf(Count);
+    std::vector<Memory::ChainCache::BatchEntry> Entries;
+    for (size_t i = 0; i < Count; i++) {
+        const Character& Ch = Chars[i];
+        ChainsOf[i] = {
+            Chains::LineColor(Ch.ID, Ch.Current_Pallete_Num),
+            Chains::SuperShadow(Ch.ID, Ch.Current_Pallete_Num),
+            Chains::PaletteColors(Ch.ID, Ch.Current_Pallete_Num)
+        };
+        Entries.push_back(Memory::ChainCache::Entry(ChainsOf[i].LineColor));
+        Entries.push_back(Memory::ChainCache::Entry(ChainsOf[i].SuperShadow));
+        Entries.push_back(Memory::ChainCache::Entry(ChainsOf[i].Colors));
+    }
+    Cache.ResolveBatch(SG_Process, BaseAddress, Entries.data(), Entries.size());
+
+    struct PalleteValues {
+        __int32 LineColor = 0;
+        __int32 SuperShadows[2] = {}; // both colors sit next to each other
+        std::vector<__int32> Colors;
+        size_t FirstSpan = 0;
+        size_t SpanCount = 0;
+    };
+    std::vector<PalleteValues> Values(Count);
+    std::vector<Memory::Span> Spans;
+    for (size_t i = 0; i < Count; i++) {
+        const Memory::ChainCache::BatchEntry* Entry = &Entries[i * 3];
+        if (!Entry[0].bResolved || !Entry[1].bResolved || !Entry[2].bResolved) {
+            continue;
+        }
+        PalleteValues& Value = Values[i];
+        Value.Colors.resize((std::max)(Chars[i].Num_Of_Color, 0));
+        Value.FirstSpan = Spans.size();
+        Spans.push_back({ Entry[0].Address, &Value.LineColor, sizeof(Value.LineColor) });
+        Spans.push_back({ Entry[1].Address, Value.SuperShadows, sizeof(Value.SuperShadows) });
+        if (!Value.Colors.empty()) {
+            Spans.push_back({ Entry[2].Address, Value.Colors.data(), Value.Colors.size() * sizeof(__int32) });
+        }
+        Value.SpanCount = Spans.size() - Value.FirstSpan;
+    }
+    // Pages we do not mirror yet (first read, new palette) come in with one refresh
+    bool bCovered = true;
+    for (size_t i = 0; i < Count; i++) {
+        for (size_t k = Values[i].FirstSpan; k < Values[i].FirstSpan + Values[i].SpanCount; k++) {
+            TrackPallete(Chars[i].ID, Chars[i].Current_Pallete_Num, Spans[k].Address, Spans[k].Size);
+            bCovered &= Mirror.Covers(Spans[k].Address, Spans[k].Size);
+        }
+    }
+    if (!bCovered) {
+        Mirror.Refresh(SG_Process);
+    }
+
+    for (size_t i = 0; i < Count; i++) {
+        Character& Ch = Chars[i];
+        PalleteValues& Value = Values[i];
+        bool bRead = Value.SpanCount != 0;
+        for (size_t k = Value.FirstSpan; bRead && k < Value.FirstSpan + Value.SpanCount; k++) {
+            bRead = Mirror.Read(Spans[k].Address, Spans[k].Buffer, Spans[k].Size);
+        }
+
+        // Remember what the game holds now, so later writes can skip unchanged bytes
+        if (bRead) {
+            Ch.LineColor = Value.LineColor;
+            Ch.SuperShadowColor1 = Value.SuperShadows[0];
+            Ch.SuperShadowColor2 = Value.SuperShadows[1];
+            Ch.Character_Colors = std::move(Value.Colors);
+            Shadows[Ch.ID] = Ch;
+            StoreSlot(Ch);
+        }
+        else {
+            Shadows.erase(Ch.ID);
+        }
+    }
+}
+
+void PalEdit::ReadAllPalletes(const Character& Ch) {
+    // Chains of every slot first, entries point into them
+    int SlotCount = (std::max)(Ch.Max_Pallete_Num, 0);
+    std::vector<Memory::Chain<5>> LineColorChains(SlotCount);
+    std::vector<Memory::Chain<6>> SuperShadowChains(SlotCount);
+    std::vector<Memory::Chain<6>> ColorChains(SlotCount);
+    std::vector<Memory::ChainCache::BatchEntry> Entries;
+    for (int Pal{ 0 }; Pal < SlotCount; Pal++) {
+        LineColorChains[Pal] = Chains::LineColor(Ch.ID, Pal);
+        SuperShadowChains[Pal] = Chains::SuperShadow(Ch.ID, Pal);
+        ColorChains[Pal] = Chains::PaletteColors(Ch.ID, Pal);
+        Entries.push_back(Memory::ChainCache::Entry(LineColorChains[Pal]));
+        Entries.push_back(Memory::ChainCache::Entry(SuperShadowChains[Pal]));
+        Entries.push_back(Memory::ChainCache::Entry(ColorChains[Pal]));
+    }
+    Cache.ResolveBatch(SG_Process, BaseAddress, Entries.data(), Entries.size());
+
+    PalleteSlots Slots;
+    Slots.Num_Of_Color = (std::max)(Ch.Num_Of_Color, 0);
+    Slots.Colors.resize(static_cast<size_t>(SlotCount) * Slots.Num_Of_Color);
+    Slots.LineColors.resize(SlotCount);
+    Slots.SuperShadows.resize(static_cast<size_t>(SlotCount) * 2);
+    Slots.bValid.resize(SlotCount, false);
+
+    // Every slot through the mirror, the pages it lacks come in with one refresh.
+    // The slots other than the current one are mirrored until the next poll only.
+    std::vector<Memory::Span> Spans;
+    std::vector<int> SpanSlots;
+    bool bCovered = true;
+    for (int Pal{ 0 }; Pal < SlotCount; Pal++) {
+        const Memory::ChainCache::BatchEntry* Entry = &Entries[Pal * 3];
+        if (!Entry[0].bResolved || !Entry[1].bResolved || !Entry[2].bResolved) {
+            continue;
+        }
+        Spans.push_back({ Entry[0].Address, &Slots.LineColors[Pal], sizeof(__int32) });
+        Spans.push_back({ Entry[1].Address, &Slots.SuperShadows[Pal * 2], 2 * sizeof(__int32) });
+        Spans.push_back({ Entry[2].Address, Slots.Colors.data() + Pal * Slots.Num_Of_Color, Slots.Num_Of_Color * sizeof(__int32) });
+        SpanSlots.push_back(Pal);
+    }
+    for (const Memory::Span& Span : Spans) {
+        Mirror.Track(Span.Address, Span.Size);
+        bCovered &= Mirror.Covers(Span.Address, Span.Size);
+    }
+    bRetrack |= SlotCount > 1;
+    if (!bCovered) {
+        Mirror.Refresh(SG_Process);
+    }
+    for (size_t i = 0; i < SpanSlots.size(); i++) {
+        bool bRead = true;
+        for (size_t k = i * 3; k < i * 3 + 3; k++) {
+            bRead &= Mirror.Read(Spans[k].Address, Spans[k].Buffer, Spans[k].Size);
+        }
+        Slots.bValid[SpanSlots[i]] = bRead;
+    }
+    SlotCache[Ch.ID] = Slots;
+    PublishedSlots[Ch.ID] = std::make_shared<const PalleteSlots>(std::move(Slots));
+    Publish();
+}
+
+bool PalEdit::PalleteSlots::Holds(int Pallete_Num) const {
+    return Pallete_Num >= 0 && Pallete_Num < static_cast<int>(bValid.size()) && bValid[Pallete_Num];
+}
+
+bool PalEdit::PalleteSlots::Load(Character& Ch) const {
+    int Pal = Ch.Current_Pallete_Num;
+    if (!Holds(Pal)) {
+        return false;
+    }
+    auto First = Colors.begin() + Pal * Num_Of_Color;
+    Ch.Character_Colors.assign(First, First + Num_Of_Color);
+    Ch.LineColor = LineColors[Pal];
+    Ch.SuperShadowColor1 = SuperShadows[Pal * 2];
+    Ch.SuperShadowColor2 = SuperShadows[Pal * 2 + 1];
+    return true;
+}
+
+void PalEdit::PalleteSlots::Store(const Character& Ch) {
+    int Pal = Ch.Current_Pallete_Num;
+    if (Pal < 0 || Pal >= static_cast<int>(bValid.size()) ||
+        Ch.Character_Colors.size() != static_cast<size_t>(Num_Of_Color)) {
+        return;
+    }
+    std::copy(Ch.Character_Colors.begin(), Ch.Character_Colors.end(), Colors.begin() + Pal * Num_Of_Color);
+    LineColors[Pal] = Ch.LineColor;
+    SuperShadows[Pal * 2] = Ch.SuperShadowColor1;
+    SuperShadows[Pal * 2 + 1] = Ch.SuperShadowColor2;
+    bValid[Pal] = true;
+}
+
+bool PalEdit::LoadSlot(Character& Ch) {
+    auto it = SlotCache.find(Ch.ID);
+    return it != SlotCache.end() && it->second.Load(Ch);
+}
+
+void PalEdit::StoreSlot(const Character& Ch) {
+    auto it = SlotCache.find(Ch.ID);
+    if (it != SlotCache.end()) {
+        it->second.Store(Ch);
+    }
+}
+
+// Number of values that differ between two slots, -1 if one of them is not read yet
+int PalEdit::ComparePalletes(int First_Num, int Second_Num) {
+    auto it = LocalSlots.find(current_character_idx);
+    if (it == LocalSlots.end() || !it->second.Holds(First_Num) || !it->second.Holds(Second_Num)) {
+        return -1;
+    }
+    const PalleteSlots* Slots = &it->second;
+    int Values = 0;
+    for (int i{ 0 }; i < Slots->Num_Of_Color; i++) {
+        Values += Slots->Colors[First_Num * Slots->Num_Of_Color + i] != Slots->Colors[Second_Num * Slots->Num_Of_Color + i];
+    }
+    Values += Slots->LineColors[First_Num] != Slots->LineColors[Second_Num];
+    Values += Slots->SuperShadows[First_Num * 2] != Slots->SuperShadows[Second_Num * 2];
+    Values += Slots->SuperShadows[First_Num * 2 + 1] != Slots->SuperShadows[Second_Num * 2 + 1];
+    return Values;
+}
+
+bool PalEdit::CopyPallete(int From_Num, int To_Num) {
+    if (current_character_idx == -1 || From_Num == To_Num) {
+        return false;
+    }
+    // Edits of the palette on screen go into the local slots first
+    FlushWrites();
+    auto it = LocalSlots.find(current_character_idx);
+    if (it == LocalSlots.end() || !it->second.Holds(From_Num) ||
+        To_Num < 0 || To_Num >= static_cast<int>(it->second.bValid.size())) {
+        return false;
+    }
+    PalleteSlots& Slots = it->second;
+    int Count = Slots.Num_Of_Color;
+    std::copy_n(Slots.Colors.begin() + From_Num * Count, Count, Slots.Colors.begin() + To_Num * Count);
+    Slots.LineColors[To_Num] = Slots.LineColors[From_Num];
+    Slots.SuperShadows[To_Num * 2] = Slots.SuperShadows[From_Num * 2];
+    Slots.SuperShadows[To_Num * 2 + 1] = Slots.SuperShadows[From_Num * 2 + 1];
+    Slots.bValid[To_Num] = true;
+    // The slot on screen takes the copy as well
+    Character& Ch = Character_Vector[FindVectorIndexByID(current_character_idx)];
+    if (Ch.Current_Pallete_Num == To_Num) {
+        Slots.Load(Ch);
+    }
+    Queue(QueuedEdit::Kind::CopyPallete, current_character_idx, To_Num, From_Num);
+    return true;
+}
+
+// Watcher side: puts the cached values of one slot into another with one scatter write
+void PalEdit::ApplyCopy(int ID, int From_Num, int To_Num) {
+    auto it = SlotCache.find(ID);
+    if (it == SlotCache.end() || !it->second.Holds(From_Num) ||
+        To_Num < 0 || To_Num >= static_cast<int>(it->second.bValid.size())) {
+        return;
+    }
+    PalleteSlots* Slots = &it->second;
+    Memory::Chain<5> LineColorChain = Chains::LineColor(ID, To_Num);
+    Memory::Chain<6> SuperShadowChain = Chains::SuperShadow(ID, To_Num);
+    Memory::Chain<6> ColorChain = Chains::PaletteColors(ID, To_Num);
+    Memory::ChainCache::BatchEntry Entries[] = {
+        Memory::ChainCache::Entry(LineColorChain),
+        Memory::ChainCache::Entry(SuperShadowChain),
+        Memory::ChainCache::Entry(ColorChain)
+    };
+    Cache.ResolveBatch(SG_Process, BaseAddress, Entries, 3);
+    if (!Entries[0].bResolved || !Entries[1].bResolved || !Entries[2].bResolved) {
+        return;
+    }
+
+    int Count = Slots->Num_Of_Color;
+    std::copy_n(Slots->Colors.begin() + From_Num * Count, Count, Slots->Colors.begin() + To_Num * Count);
+    Slots->LineColors[To_Num] = Slots->LineColors[From_Num];
+    Slots->SuperShadows[To_Num * 2] = Slots->SuperShadows[From_Num * 2];
+    Slots->SuperShadows[To_Num * 2 + 1] = Slots->SuperShadows[From_Num * 2 + 1];
+    Slots->bValid[To_Num] = true;
+    Memory::Span Spans[] = {
+        { Entries[0].Address, &Slots->LineColors[To_Num], sizeof(__int32) },
+        { Entries[1].Address, &Slots->SuperShadows[To_Num * 2], 2 * sizeof(__int32) },
+        { Entries[2].Address, Slots->Colors.data() + To_Num * Count, Count * sizeof(__int32) }
+    };
+    // A write that does not make it is caught by VerifyWrites
+    for (const Memory::Span& Span : Spans) {
+        WriteQueue.Write(SG_Process, Span.Address, Span.Buffer, Span.Size);
+        Mirror.Patch(Span.Address, Span.Buffer, Span.Size);
+        RememberToVerify(ID, Span.Address, Span.Buffer, Span.Size);
+        BytesWritten += Span.Size;
+    }
+
+    // The slot on screen takes the copy as well, the UI did so already
+    for (Character& Ch : Roster) {
+        if (Ch.ID == ID && Ch.Current_Pallete_Num == To_Num && LoadSlot(Ch)) {
+            Shadows[ID] = Ch;
         }
+    }
+}
+
+// Watcher side: reads the roster's palettes again (from the mirror, refreshed this
+// tick) for the next snapshot. The shadow takes the game's values, so the next
+// edit of a diverged value is written again. Waits for a tick with no writes still
+// queued, the mirror would hand the shadow the colors they replace.
+void PalEdit::RefreshRoster() {
+    if (SentBeforeRead != WriteQueue.Queued()) {
+        return;
+    }
+    LastReconcile = std::chrono::steady_clock::now();
+    ReadPalletes(Roster.data(), Roster.size());
+    Publish();
+}
+
+// UI side: counts the values that differ between Character_Vector and the
+// palettes of a snapshot
+void PalEdit::Reconcile(const GameSnapshot& Latest) {
+    // A snapshot read before our last write would report it as diverged
+    if (FramesApplied != FramesQueued || Latest.WriteCount != WriteQueue.Queued()) {
+        return;
+    }
 
+    Divergence Found = { 0, 0 };
+    for (const Character& Game : Latest.Roster) {
+        int VectorID = FindVectorIndexByID(Game.ID);
+        if (VectorID == -1 || Pending.count(Game.ID) != 0) {
+            continue;
+        }
+        const Character& Local = Character_Vector[VectorID];
+        if (Local.Current_Pallete_Num != Game.Current_Pallete_Num) {
+            continue;
+        }
+        int Values = 0;
+        size_t Count = (std::min)(Local.Character_Colors.size(), Game.Character_Colors.size());
+        for (size_t k = 0; k < Count; k++) {
+            Values += Local.Character_Colors[k] != Game.Character_Colors[k];
+        }
+        Values += Local.LineColor != Game.LineColor;
+        Values += Local.SuperShadowColor1 != Game.SuperShadowColor1;
+        Values += Local.SuperShadowColor2 != Game.SuperShadowColor2;
+        if (Values != 0) {
+            Found.Characters++;
+            Found.Values += Values;
+        }
+    }
+    Diverged = Found;
 }
 
 void PalEdit::ChangePallete() {
+    // Edits of the palette we leave go out first, with its values
+    FlushWrites();
     int VectorID = FindVectorIndexByID(current_character_idx);
-    unsigned __int8 New_Pal = static_cast<unsigned __int8>(Character_Vector[VectorID].Current_Pallete_Num);
-    Memory::WriteProcessMemoryWithOffsets(
-        s_SG_Process,
-        s_BaseAddress, {
-        static_cast<uintptr_t>(AddressTable::Base_Adress()),
-        static_cast<uintptr_t>(AddressTable::Offset_Character() + current_character_idx * 4),  //    
-        static_cast<uintptr_t>(AddressTable::Offset_CurrentPalette()),
-        },
-        New_Pal
-        );
+    Character& Ch = Character_Vector[VectorID];
+    // Colors of the new palette come from the local slots, with the next snapshot
+    // if the watcher has not read them yet
+    auto it = LocalSlots.find(Ch.ID);
+    bool bLoaded = it != LocalSlots.end() && it->second.Load(Ch);
+    Queue(QueuedEdit::Kind::SwitchPallete, Ch.ID, Ch.Current_Pallete_Num, bLoaded ? 1 : 0);
+}
+
+// Watcher side
+void PalEdit::ApplySwitch(int ID, int Pallete_Num, bool bLoaded) {
+    for (Character& Ch : Roster) {
+        if (Ch.ID != ID) {
+            continue;
+        }
+        uint8_t New_Pal = static_cast<uint8_t>(Pallete_Num);
+        uintptr_t Address;
+        if (Cache.Resolve(SG_Process, BaseAddress, Chains::CurrentPalette(ID), &Address)) {
+            WriteQueue.Write(SG_Process, Address, &New_Pal, sizeof(New_Pal));
+        }
+        Ch.Current_Pallete_Num = Pallete_Num;
+        // Colors of the new palette come from the slot cache, read only if it lacks them
+        if (LoadSlot(Ch)) {
+            Shadows[ID] = Ch;
+        }
+        else {
+            ReadPalletes(&Ch, 1);
+        }
+        if (!bLoaded) {
+            PaletteVersions[ID]++;
+            Publish();
+        }
+    }
 }
 
 void PalEdit::ChangeColor(int Color_ID, __int32 colorValue) {
     int VectorID = FindVectorIndexByID(current_character_idx);
-    Memory::WriteProcessMemoryWithOffsets(
-        s_SG_Process,
-        s_BaseAddress, {
-        static_cast<uintptr_t>(AddressTable::Base_Adress()),
-        static_cast<uintptr_t>(AddressTable::Offset_Character() + current_character_idx * 4),  //    
-        static_cast<uintptr_t>(AddressTable::Offset_PaletteData()),
-        static_cast<uintptr_t>(AddressTable::Offset_ColorCodeOffset()),
-        static_cast<uintptr_t>(4 * Character_Vector[VectorID].Current_Pallete_Num),
-        static_cast<uintptr_t>(4 * Color_ID)
-        },
-        colorValue
-        );
+    Character& Ch = Character_Vector[VectorID];
+    if (Color_ID < 0 || Color_ID >= static_cast<int>(Ch.Character_Colors.size())) {
+        return;
+    }
+    Ch.Character_Colors[Color_ID] = colorValue;
+    MarkColorDirty(Ch, Color_ID);
 }
 
 void PalEdit::ChangeAllColors() {
-    Character currentChar = PalEdit::Character_Vector[PalEdit::FindVectorIndexByID(PalEdit::current_character_idx)];
-    for (int i = 0; i < currentChar.Character_Colors.size(); i++) {
-        ChangeColor(i, currentChar.Character_Colors[i]);
+    const Character& currentChar = Character_Vector[FindVectorIndexByID(current_character_idx)];
+    for (size_t i = 0; i < currentChar.Character_Colors.size(); i++) {
+        MarkColorDirty(currentChar, static_cast<int>(i));
     }
 }
 
-void PalEdit::NODisplayChar() {
-    static char MEM[] = {0x77, 0x23};
-    if (bNODisplayChar) {
-        
-        const char NOPE[] = { 0x90, 0x90 };
-        Memory::WriteProcessMemoryWithOffsets(
-            s_SG_Process,
-            s_BaseAddress, {
-            static_cast<uintptr_t>(AddressTable::NEW_Base_Adress_DonotdisplayCHAR())  //    
-            },
-            NOPE);
+void PalEdit::MarkColorDirty(const Character& Ch, int Color_ID) {
+    auto it = Pending.find(Ch.ID);
+    if (it != Pending.end() && it->second.Pallete_Num != Ch.Current_Pallete_Num) {
+        // Palette was switched under pending edits, push them to the old palette first
+        FlushWrites();
+        it = Pending.end();
+    }
+    if (it == Pending.end()) {
+        it = Pending.emplace(Ch.ID, PendingColors{ Ch.Current_Pallete_Num, {} }).first;
+    }
+    MarkUncommitted(Ch.ID);
+    std::vector<bool>& Dirty = it->second.Dirty;
+    if (Dirty.size() < Ch.Character_Colors.size()) {
+        Dirty.resize(Ch.Character_Colors.size(), false);
+    }
+    Dirty[Color_ID] = true;
+}
 
+void PalEdit::Queue(QueuedEdit::Kind What, int ID, int Pallete_Num, int First, int Count) {
+    if (What != QueuedEdit::Kind::ReadSlots && What != QueuedEdit::Kind::Toggles) {
+        MarkUncommitted(ID);
     }
-    else {
-        Memory::WriteProcessMemoryWithOffsets(
-            s_SG_Process,
-            s_BaseAddress, {
-            static_cast<uintptr_t>(AddressTable::NEW_Base_Adress_DonotdisplayCHAR())  //    
-            },
-            MEM);
+    FrameEdits.push_back({ What, ID, Pallete_Num, First, Count, nullptr });
+}
+
+void PalEdit::FlushWrites() {
+    // The edits go out as the characters published with them
+    CommitToModel();
+    if (Pending.empty() && FrameEdits.empty()) {
+        return;
+    }
+    EditFrame Frame;
+    Frame.RosterGeneration = AdoptedGeneration;
+    std::copy(std::begin(AdoptedSlotVersions), std::end(AdoptedSlotVersions), std::begin(Frame.SlotVersions));
+    Frame.bReport = bReportFrame;
+    Frame.bVerify = bVerifyWrites;
+    bReportFrame = false;
+    // Every contiguous run of edited colors, the watcher skips the ones the game
+    // already holds
+    for (const auto& [ID, Pending] : Pending) {
+        auto Source = InModel.find(ID);
+        if (Source == InModel.end()) {
+            continue;
+        }
+        size_t Count = (std::min)(Pending.Dirty.size(), Source->second->Character_Colors.size());
+        size_t i = 0;
+        while (i < Count) {
+            if (!Pending.Dirty[i]) {
+                i++;
+                continue;
+            }
+            size_t Start = i;
+            while (i < Count && Pending.Dirty[i]) {
+                i++;
+            }
+            Frame.Edits.push_back({ QueuedEdit::Kind::Colors, ID, Pending.Pallete_Num, static_cast<int>(Start),
+                static_cast<int>(i - Start), Source->second });
+        }
+    }
+    Pending.clear();
+    for (QueuedEdit& Edit : FrameEdits) {
+        bool bValue = Edit.What == QueuedEdit::Kind::LineColor || Edit.What == QueuedEdit::Kind::SuperShadow;
+        auto Source = InModel.find(Edit.ID);
+        if (Source != InModel.end()) {
+            Edit.Source = Source->second;
+        }
+        else if (bValue) {
+            continue;
+        }
+        Frame.Edits.push_back(std::move(Edit));
+    }
+    FrameEdits.clear();
+    for (const QueuedEdit& Edit : Frame.Edits) {
+        KeepLocally(Edit);
     }
+
+    FramesQueued++;
+    {
+        std::lock_guard<std::mutex> Lock(OutboxLock);
+        Outbox.push_back(std::move(Frame));
+    }
+    WakeWatchers();
 }
 
-void PalEdit::NODisplayShadow() {
-    static char MEM[] = {0x75, 0x1E};
-    if (bNODisplayShadows) {
+void PalEdit::KeepLocally(const QueuedEdit& Edit) {
+    auto it = LocalSlots.find(Edit.ID);
+    if (it == LocalSlots.end() || !it->second.Holds(Edit.Pallete_Num)) {
+        return;
+    }
+    PalleteSlots& Slots = it->second;
+    switch (Edit.What) {
+    case QueuedEdit::Kind::Colors:
+        if (Edit.First >= 0 && Edit.First + Edit.Count <= Slots.Num_Of_Color) {
+            auto First = Edit.Source->Character_Colors.begin() + Edit.First;
+            std::copy(First, First + Edit.Count, Slots.Colors.begin() + Edit.Pallete_Num * Slots.Num_Of_Color + Edit.First);
+        }
+        break;
+    case QueuedEdit::Kind::LineColor:
+        Slots.LineColors[Edit.Pallete_Num] = Edit.Source->LineColor;
+        break;
+    case QueuedEdit::Kind::SuperShadow:
+        Slots.SuperShadows[Edit.Pallete_Num * 2 + (Edit.First == 0 ? 0 : 1)] =
+            Edit.First == 0 ? Edit.Source->SuperShadowColor1 : Edit.Source->SuperShadowColor2;
+        break;
+    default:
+        break;
+    }
+}
+
+void PalEdit::ApplyEdits() {
+    std::vector<EditFrame> Frames;
+    {
+        std::lock_guard<std::mutex> Lock(OutboxLock);
+        Frames.swap(Outbox);
+    }
+    if (Frames.empty()) {
+        return;
+    }
+    int Writes = 0;
+    int Colors = 0;
+    // Everything the UI edited since the last tick shows up in the same game frame
+    WriteQueue.BeginEdit();
+    for (const EditFrame& Frame : Frames) {
+        size_t WrittenBefore = BytesWritten;
+        size_t SkippedBefore = BytesSkipped;
+        bVerifying = Frame.bVerify;
+        for (const QueuedEdit& Edit : Frame.Edits) {
+            if (Edit.What == QueuedEdit::Kind::Toggles) {
+                SyncPatches(Edit.First);
+                continue;
+            }
+            // Edits made for a roster or a slot that was read anew since are dropped
+            if (State != AttachState::InMatch || Frame.RosterGeneration != RosterGeneration ||
+                Edit.ID < 0 || Edit.ID >= CHARACTER_SLOT_COUNT || Frame.SlotVersions[Edit.ID] != SlotVersions[Edit.ID]) {
+                continue;
+            }
+            switch (Edit.What) {
+            case QueuedEdit::Kind::Colors:
+                if (Edit.First >= 0 && static_cast<size_t>(Edit.First + Edit.Count) <= Edit.Source->Character_Colors.size()) {
+                    ApplyColors(Edit.ID, Edit.Pallete_Num, Edit.First, Edit.Source->Character_Colors.data() + Edit.First, Edit.Count);
+                    Writes++;
+                    Colors += Edit.Count;
+                }
+                break;
+            case QueuedEdit::Kind::LineColor:
+                ApplyValue(Edit.ID, Edit.Pallete_Num, &Character::LineColor, Edit.Source->LineColor);
+                break;
+            case QueuedEdit::Kind::SuperShadow: {
+                __int32 Character::* Field = Edit.First == 0 ? &Character::SuperShadowColor1 : &Character::SuperShadowColor2;
+                ApplyValue(Edit.ID, Edit.Pallete_Num, Field, (*Edit.Source).*Field);
+                break;
+            }
+            case QueuedEdit::Kind::SwitchPallete:
+                ApplySwitch(Edit.ID, Edit.Pallete_Num, Edit.First != 0);
+                break;
+            case QueuedEdit::Kind::CopyPallete:
+                ApplyCopy(Edit.ID, Edit.First, Edit.Pallete_Num);
+                break;
+            case QueuedEdit::Kind::ReadSlots:
+                for (const Character& Ch : Roster) {
+                    if (Ch.ID == Edit.ID) {
+                        ReadAllPalletes(Ch);
+                    }
+                }
+                break;
+            case QueuedEdit::Kind::Toggles:
+                break;
+            }
+        }
+        if (Frame.bReport) {
+            std::lock_guard<std::mutex> Lock(SnapshotLock);
+            UpdateReport = { BytesWritten - WrittenBefore, BytesSkipped - SkippedBefore };
+        }
+    }
+    WriteQueue.EndEdit();
+    WritesFlushed = Writes;
+    ColorsFlushed = Colors;
+    FramesApplied += Frames.size();
+}
 
-        const char NOPE[] = { 0xEB, 0x1B };
-        Memory::WriteProcessMemoryWithOffsets(
-            s_SG_Process,
-            s_BaseAddress, {
-            static_cast<uintptr_t>(AddressTable::NEW_Base_Adress_DonotdisplaySHADOWS())  //    
-            },
-            NOPE);
+// Writes the runs of Values the game does not hold yet
+void PalEdit::ApplyColors(int ID, int Pallete_Num, int First, const __int32* Values, size_t Count) {
+    Character* Shadow = FindShadow(ID, Pallete_Num);
+    auto NeedsWrite = [&](size_t k) {
+        size_t idx = First + k;
+        return !(Shadow && idx < Shadow->Character_Colors.size() && Shadow->Character_Colors[idx] == Values[k]);
+    };
+    // Every contiguous run of such colors goes out as one write
+    size_t i = 0;
+    while (i < Count) {
+        if (!NeedsWrite(i)) {
+            BytesSkipped += sizeof(__int32);
+            i++;
+            continue;
+        }
+        size_t Start = i;
+        while (i < Count && NeedsWrite(i)) {
+            i++;
+        }
+        bool bWritten = WriteMirrored(ID, Chains::PaletteColors(ID, Pallete_Num, First + static_cast<int>(Start)), &Values[Start], i - Start);
+        BytesWritten += (i - Start) * sizeof(__int32);
+        if (bWritten && Shadow && First + i <= Shadow->Character_Colors.size()) {
+            std::copy(Values + Start, Values + i, Shadow->Character_Colors.begin() + First + Start);
+        }
+    }
+    if (Shadow) {
+        StoreSlot(*Shadow);
+    }
+}
 
+// Writes a line color or super shadow, unless the game holds it already
+void PalEdit::ApplyValue(int ID, int Pallete_Num, __int32 Character::* Field, __int32 Value) {
+    Character* Shadow = FindShadow(ID, Pallete_Num);
+    if (Shadow && Shadow->*Field == Value) {
+        BytesSkipped += sizeof(__int32);
+        return;
     }
-    else {
-        Memory::WriteProcessMemoryWithOffsets(
-            s_SG_Process,
-            s_BaseAddress, {
-            static_cast<uintptr_t>(AddressTable::NEW_Base_Adress_DonotdisplaySHADOWS())  //    
-            },
-            MEM);
+    BytesWritten += sizeof(__int32);
+    bool bWritten = Field == &Character::LineColor
+        ? WriteMirrored(ID, Chains::LineColor(ID, Pallete_Num), &Value)
+        : WriteMirrored(ID, Chains::SuperShadow(ID, Pallete_Num, Field == &Character::SuperShadowColor1 ? 0 : 1), &Value);
+    if (bWritten && Shadow) {
+        Shadow->*Field = Value;
+        StoreSlot(*Shadow);
     }
 }
 
-void PalEdit::DisplaySuperShadow() {
-    static char MEM[6] = { 0x0F, 0x8B,0x22, 0x01, 0x00, 0x00 };
-    if (bDisplaySuperShadows) {
+void PalEdit::RememberToVerify(int ID, uintptr_t Address, const void* Data, size_t Size) {
+    if (!bVerifying) {
+        return;
+    }
+    // Writes queue up until the writer sent them, older ones may lie under this one
+    const char* Bytes = static_cast<const char*>(Data);
+    bool bSameRange = false;
+    for (WrittenSpan& Older : WrittenSpans) {
+        bSameRange |= Older.Address == Address && Older.Size == Size;
+        uintptr_t Start = (std::max)(Older.Address, Address);
+        uintptr_t End = (std::min)(Older.Address + Older.Size, Address + Size);
+        if (Start < End) {
+            std::copy(Bytes + (Start - Address), Bytes + (End - Address), Older.Bytes.begin() + (Start - Older.Address));
+            Older.Hash = Memory::Hash(Older.Bytes.data(), Older.Size);
+            Older.Write = WriteQueue.Queued();
+        }
+    }
+    if (!bSameRange) {
+        WrittenSpans.push_back({ ID, Address, Size, std::vector<char>(Bytes, Bytes + Size), Memory::Hash(Data, Size), WriteQueue.Queued(), false });
+    }
+}
 
-        const char NOPE[] = { 0x90, 0x90,0x90,0x90,0x90,0x90, };
-        Memory::WriteProcessMemoryWithOffsets(
-            s_SG_Process,
-            s_BaseAddress, {
-            static_cast<uintptr_t>(AddressTable::NEW_Base_Adress_Display_SuperShadowforever())  //    
-            },
-            NOPE);
+void PalEdit::ForgetWritten(int ID) {
+    WrittenSpans.erase(std::remove_if(WrittenSpans.begin(), WrittenSpans.end(),
+        [ID](const WrittenSpan& Span) { return Span.ID == ID; }), WrittenSpans.end());
+}
 
+// Watcher side, every poll in a match: checks the ranges the writer sent by now,
+// the others wait for a later poll
+void PalEdit::VerifyWrites() {
+    uint64_t Sent = WriteQueue.Sent();
+    auto Unsent = std::partition(WrittenSpans.begin(), WrittenSpans.end(),
+        [Sent](const WrittenSpan& Span) { return Span.Write > Sent; });
+    if (Unsent == WrittenSpans.end()) {
+        return;
+    }
+    std::vector<WrittenSpan> Written(std::make_move_iterator(Unsent), std::make_move_iterator(WrittenSpans.end()));
+    WrittenSpans.erase(Unsent, WrittenSpans.end());
+
+    // Ranges sent before this poll's refresh are in the mirror as the game holds
+    // them, the rest is read from the game with one scatter read
+    size_t Total = 0;
+    for (const WrittenSpan& Span : Written) {
+        Total += Span.Size;
+    }
+    std::vector<char> Game(Total);
+    std::vector<bool> bRead(Written.size(), false);
+    std::vector<Memory::Span> Spans;
+    std::vector<size_t> SpanOf;
+    size_t Offset = 0;
+    size_t ReadBack = 0;
+    for (size_t i = 0; i < Written.size(); i++) {
+        const WrittenSpan& Span = Written[i];
+        if (Span.Write <= SentBeforeRead && Mirror.Read(Span.Address, Game.data() + Offset, Span.Size)) {
+            bRead[i] = true;
+        }
+        else {
+            Spans.push_back({ Span.Address, Game.data() + Offset, Span.Size });
+            SpanOf.push_back(i);
+            ReadBack += Span.Size;
+        }
+        Offset += Span.Size;
+    }
+    if (!Spans.empty()) {
+        std::vector<bool> bReadEach;
+        Memory::ReadEach(SG_Process, Spans.data(), Spans.size(), &bReadEach);
+        for (size_t k = 0; k < Spans.size(); k++) {
+            bRead[SpanOf[k]] = bReadEach[k];
+        }
     }
-    else {
-        Memory::WriteProcessMemoryWithOffsets(
-            s_SG_Process,
-            s_BaseAddress, {
-            static_cast<uintptr_t>(AddressTable::NEW_Base_Adress_Display_SuperShadowforever())  //    
-            },
-            MEM);
+
+    // Something else wrote there, most likely the game reloading the palette.
+    // Such a range is sent once more, if it is overwritten again the game keeps it.
+    std::vector<int> Mismatched;
+    Offset = 0;
+    WriteQueue.BeginEdit();
+    for (size_t i = 0; i < Written.size(); i++) {
+        WrittenSpan& Span = Written[i];
+        bool bSame = bRead[i] && Memory::Hash(Game.data() + Offset, Span.Size) == Span.Hash;
+        Offset += Span.Size;
+        if (bSame) {
+            continue;
+        }
+        if (std::find(Mismatched.begin(), Mismatched.end(), Span.ID) == Mismatched.end()) {
+            Mismatched.push_back(Span.ID);
+        }
+        if (Span.bResent) {
+            // The shadow no longer says what the game holds
+            Shadows.erase(Span.ID);
+            continue;
+        }
+        WriteQueue.Write(SG_Process, Span.Address, Span.Bytes.data(), Span.Size);
+        Mirror.Patch(Span.Address, Span.Bytes.data(), Span.Size);
+        Span.Write = WriteQueue.Queued();
+        Span.bResent = true;
+        WrittenSpans.push_back(std::move(Span));
+    }
+    WriteQueue.EndEdit();
+
+    std::lock_guard<std::mutex> Lock(SnapshotLock);
+    Verified = { static_cast<int>(Written.size()), ReadBack, static_cast<int>(Mismatched.size()) };
+}
+
+PalEdit::VerifyReport PalEdit::LastVerify() {
+    std::lock_guard<std::mutex> Lock(SnapshotLock);
+    return Verified;
+}
+
+PalEdit::WriteReport PalEdit::LastUpdateReport() {
+    std::lock_guard<std::mutex> Lock(SnapshotLock);
+    return UpdateReport;
+}
+
+Character* PalEdit::FindShadow(int ID, int Pallete_Num) {
+    auto it = Shadows.find(ID);
+    if (it == Shadows.end() || it->second.Current_Pallete_Num != Pallete_Num) {
+        return nullptr;
     }
+    return &it->second;
+}
+
+void PalEdit::NODisplayChar() {
+    QueueToggles();
+}
+
+void PalEdit::NODisplayShadow() {
+    QueueToggles();
+}
+
+void PalEdit::DisplaySuperShadow() {
+    QueueToggles();
+}
+
+void PalEdit::QueueToggles() {
+    int Toggles = (bNODisplayChar ? TOGGLE_NODISPLAY_CHAR : 0) |
+        (bNODisplayShadows ? TOGGLE_NODISPLAY_SHADOWS : 0) |
+        (bDisplaySuperShadows ? TOGGLE_DISPLAY_SUPER_SHADOWS : 0);
+    Queue(QueuedEdit::Kind::Toggles, -1, 0, Toggles);
+}
+
+// Watcher side, the patches are there while attached
+void PalEdit::SyncPatches(int Toggles) {
+    if (State == AttachState::Detached) {
+        return;
+    }
+    Patches.Want(NODisplayCharPatch, (Toggles & TOGGLE_NODISPLAY_CHAR) != 0);
+    Patches.Want(NODisplayShadowsPatch, (Toggles & TOGGLE_NODISPLAY_SHADOWS) != 0);
+    Patches.Want(DisplaySuperShadowsPatch, (Toggles & TOGGLE_DISPLAY_SUPER_SHADOWS) != 0);
+    Patches.Sync(SG_Process);
 }
 
 void PalEdit::ChangeLineColor() {
-    int VectorID = FindVectorIndexByID(current_character_idx);
-    Memory::WriteProcessMemoryWithOffsets(
-        s_SG_Process,
-        s_BaseAddress, {
-        static_cast<uintptr_t>(AddressTable::Base_Adress()),
-        static_cast<uintptr_t>(AddressTable::Offset_Character() + current_character_idx * 4),  //    
-        static_cast<uintptr_t>(AddressTable::Offset_PaletteData()),
-        static_cast<uintptr_t>(AddressTable::NEW_Offset_LineColor()),
-        static_cast<uintptr_t>(4 * Character_Vector[VectorID].Current_Pallete_Num),
-        },
-        Character_Vector[VectorID].LineColor
-        );
+    const Character& Ch = Character_Vector[FindVectorIndexByID(current_character_idx)];
+    Queue(QueuedEdit::Kind::LineColor, Ch.ID, Ch.Current_Pallete_Num);
 }
+
 void PalEdit::ChangeSuperShadow1() {
-    int VectorID = FindVectorIndexByID(current_character_idx);
-    Memory::WriteProcessMemoryWithOffsets(
-        s_SG_Process,
-        s_BaseAddress, {
-        static_cast<uintptr_t>(AddressTable::Base_Adress()),
-        static_cast<uintptr_t>(AddressTable::Offset_Character() + current_character_idx * 4),  //    
-        static_cast<uintptr_t>(AddressTable::Offset_PaletteData()),
-        static_cast<uintptr_t>(AddressTable::NEW_Offset_SuperShadow()),
-        static_cast<uintptr_t>(4 * Character_Vector[VectorID].Current_Pallete_Num),
-        0
-        },
-        Character_Vector[VectorID].SuperShadowColor1
-    );
+    const Character& Ch = Character_Vector[FindVectorIndexByID(current_character_idx)];
+    Queue(QueuedEdit::Kind::SuperShadow, Ch.ID, Ch.Current_Pallete_Num, 0);
 }
+
 void PalEdit::ChangeSuperShadow2() {
-    int VectorID = FindVectorIndexByID(current_character_idx);
-    Memory::WriteProcessMemoryWithOffsets(
-        s_SG_Process,
-        s_BaseAddress, {
-        static_cast<uintptr_t>(AddressTable::Base_Adress()),
-        static_cast<uintptr_t>(AddressTable::Offset_Character() + current_character_idx * 4),  //    
-        static_cast<uintptr_t>(AddressTable::Offset_PaletteData()),
-        static_cast<uintptr_t>(AddressTable::NEW_Offset_SuperShadow()),
-        static_cast<uintptr_t>(4 * Character_Vector[VectorID].Current_Pallete_Num),
-        4
-        },
-        Character_Vector[VectorID].SuperShadowColor2
-    );
+    const Character& Ch = Character_Vector[FindVectorIndexByID(current_character_idx)];
+    Queue(QueuedEdit::Kind::SuperShadow, Ch.ID, Ch.Current_Pallete_Num, 1);
 }
 
 void PalEdit::UpdateAllCharacters() {
-    for (Character currentChar : PalEdit::Character_Vector) {
-        current_character_idx = currentChar.ID;
-        PalEdit::ChangeAllColors();
-        PalEdit::ChangeLineColor();
-        PalEdit::ChangeSuperShadow1();
-        PalEdit::ChangeSuperShadow2();
-        PalEdit::Read_Character();
+    std::vector<int> IDs;
+    for (const Character& currentChar : Character_Vector) {
+        IDs.push_back(currentChar.ID);
     }
+    UpdateCharacters(IDs);
     current_character_idx = -1;
 }
 
+void PalEdit::UpdateCharacters(const std::vector<int>& IDs) {
+    int Selected = current_character_idx;
+    for (int ID : IDs) {
+        if (FindVectorIndexByID(ID) == -1) {
+            continue;
+        }
+        current_character_idx = ID;
+        ChangeAllColors();
+        ChangeLineColor();
+        ChangeSuperShadow1();
+        ChangeSuperShadow2();
+    }
+    current_character_idx = Selected;
+    // One frame, the game never draws a character half updated. The shadow skips
+    // what the game holds already, no need to read everything back.
+    bReportFrame = true;
+    FlushWrites();
+}
+
 
@@ -1,40 +1,420 @@
 #pragma once
 #include "pch.h"
 #include "Character.h"
+#include "Memory.h"
+#include "PollScheduler.h"
+#include "PaletteModel.h"
+#include <unordered_map>
+#include <vector>
+#include <map>
+#include <string>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
 
+// One session per running game. Sessions are found and ticked by a small pool of
+// watcher threads, every one of them has its own chain cache, mirror, patches
+// and write queue. The UI edits the Active() session.
 class PalEdit
 {
+public:
+	// Values where the game no longer holds what Character_Vector says
+	struct Divergence {
+		int Characters;
+		int Values;
+	};
+	// Every palette slot of a character, read in bulk when it is selected, so the
+	// slider and slot copies need no reads
+	struct PalleteSlots {
+		int Num_Of_Color;
+		std::vector<__int32> Colors; // Num_Of_Color per slot, slot after slot
+		std::vector<__int32> LineColors;
+		std::vector<__int32> SuperShadows; // two per slot
+		std::vector<bool> bValid;
+		bool Holds(int Pallete_Num) const;
+		// Takes the values of Ch.Current_Pallete_Num, false if they are not held
+		bool Load(Character& Ch) const;
+		void Store(const Character& Ch);
+	};
+	// What the watcher thread last saw of the game. Published whole and never
+	// changed afterwards, the UI thread only picks up the newest one.
+	struct GameSnapshot {
+		bool bGameOpenned;
+		bool bMatchStarted;
+		// Changes every time the roster is read anew
+		uint64_t RosterGeneration;
+		// Per slot, changes when only that slot was read anew
+		uint64_t SlotVersions[6];
+		// Per slot, changes when the game switched or rewrote that slot's palette
+		uint64_t PaletteVersions[6];
+		// Palettes as the game held them after WriteCount of our writes
+		std::vector<Character> Roster;
+		// Per slot, every palette slot as last read for the UI, null until it asks
+		std::shared_ptr<const PalleteSlots> Slots[6];
+		uint64_t WriteCount;
+		int ChainReads;
+		int ChainReadsSaved;
+		size_t MirroredPages;
+	};
+
+	explicit PalEdit(DWORD ProcessId = 0);
+	// The game this session belongs to, 0 for the one standing in when none runs
+	const DWORD ProcessId;
+
 private:
-	inline static DWORD s_ProcessId;
-	inline static DWORD s_BaseAddress;
-	inline static HANDLE s_SG_Process;
-	inline static int s_GameStatus;
+	// Every session, added by the discovery of the first watcher thread and
+	// removed by the UI thread once its game is gone
+	inline static std::mutex s_SessionsLock;
+	inline static std::vector<std::shared_ptr<PalEdit>> s_Sessions;
+	inline static std::vector<std::thread> s_Workers;
+	inline static std::atomic<bool> s_bWatching = false;
+	inline static int s_NextWorker = 0;
+	inline static std::atomic<int> s_DiscoveryIntervalMs = 0;
+	// Watchers sleep on this between ticks, edits from the UI wake them early
+	inline static std::mutex s_WakeLock;
+	inline static std::condition_variable s_Wake;
+	inline static uint64_t s_WakeCount = 0;
+	static void WakeWatchers();
+	// The watchers read AddressTable while they tick and hold this shared meanwhile.
+	// A table the UI loads waits until it can take it whole, a frame or so.
+	inline static std::shared_mutex s_TableLock;
+	inline static std::string s_PendingTable;
+	static void ApplyPendingTable();
+	// UI thread only
+	inline static std::shared_ptr<PalEdit> s_Active;
+	static void WatchSessions(int Worker);
+	// True if a game was found or is gone
+	static bool Discover();
+
+	// Everything below that talks to the game (chain cache, mirror, shadow, slot
+	// cache, patches) is the watcher's and used under this lock. The UI never takes
+	// it: edits are queued, palette slots come with the snapshots.
+	std::recursive_mutex GameLock;
+	// The watcher thread that ticks this session
+	int Worker = 0;
+	// Set by discovery once the process is no longer listed
+	std::atomic<bool> bProcessGone = false;
+	// Detached for good, the UI thread drops the session
+	std::atomic<bool> bEnded = false;
+	// A new table came in, patches and the frame counter are in the old places
+	std::atomic<bool> bTableChanged = false;
+	// Polls the game if it is time to, returns when it is time next
+	PollScheduler::Clock::time_point Tick();
+
+	// Watcher side: the roster it read and the snapshots it publishes
+	std::vector<Character> Roster;
+	uint64_t RosterGeneration = 0;
+	// Writes the writer had sent when the game was last read
+	uint64_t SentBeforeRead = 0;
+	std::mutex SnapshotLock;
+	std::shared_ptr<const GameSnapshot> Published;
+	uint64_t SlotVersions[6] = {};
+	uint64_t PaletteVersions[6] = {};
+	std::shared_ptr<const PalleteSlots> PublishedSlots[6];
+	void Publish();
+	void RefreshRoster();
+	// The current palette of a slot as the mirror held it at the last poll
+	struct PaletteSample {
+		bool bValid;
+		int Pallete_Num;
+		uint64_t Hash;
+	};
+	PaletteSample Samples[6] = {};
+	// Slots whose palette the game switched or rewrote since the last poll, as bits
+	int SamplePalletes();
+	void RereadPalletes(int Slots);
+	// UI side: the snapshot Character_Vector was last brought up to date with
+	std::shared_ptr<const GameSnapshot> Adopted;
+	uint64_t AdoptedGeneration = 0;
+	uint64_t AdoptedSlotVersions[6] = {};
+	uint64_t AdoptedPaletteVersions[6] = {};
+	void Adopt();
+	void AdoptRoster(const GameSnapshot& Snapshot);
+	void AdoptSlots(const GameSnapshot& Snapshot);
+	void AdoptPalletes(const GameSnapshot& Snapshot);
+	// UI side: every palette slot of the characters the UI asked for, with its own
+	// edits in. Slot switches, copies and comparisons never wait for the watcher.
+	std::unordered_map<int, PalleteSlots> LocalSlots;
+	std::shared_ptr<const PalleteSlots> AdoptedSlots[6];
+	void AdoptSlotCache(const GameSnapshot& Snapshot);
+
+	// The palettes other threads read and edit. The UI thread edits Character_Vector
+	// in place (the widgets need that) and publishes what it changed once a frame.
+	PaletteModel Palettes;
+	// UI side: per character ID, the published character Character_Vector last equaled
+	std::unordered_map<int, std::shared_ptr<const Character>> InModel;
+	uint64_t AdoptedModelVersion = 0;
+	// UI side: characters changed since the last commit, by ID. Every edit and
+	// adoption marks what it changed, so a commit compares nothing else.
+	std::vector<int> Uncommitted;
+	bool bRosterUncommitted = true;
+	void MarkUncommitted(int ID);
+	void CommitToModel();
+	// Takes what other threads published into Character_Vector and writes it to the game
+	void AdoptFromModel();
+
+	DWORD BaseAddress = 0;
+	Memory::ProcessHandle SG_Process = {};
+	int GameStatus = 0;
+
+	// Detached: the process is there, attaching is tried every poll.
+	// Attached: one open handle, the code cave is in, the status is polled.
+	// InMatch: the roster is read, the mirror is refreshed every poll.
+	enum class AttachState {
+		Detached,
+		Attached,
+		InMatch
+	};
+	AttachState State = AttachState::Detached;
+	// Every state polls at its own pace, faster while the game is changing
+	PollScheduler Poll;
+	PollScheduler::Load PollLoad = { 0, 0, 0, 0 };
+	void SetPollBounds();
+	bool Attach();
+	void Detach();
+	// Takes the patches out and closes the handle, the next poll attaches again
+	void Release();
+	void EnterMatch();
+	void LeaveMatch();
+	// True if the match changed (slots, status), it is polled faster then
+	bool UpdateMatch();
+	void RebuildRoster();
+	// Slots is a bit set, slot n is bit n
+	void RebuildSlots(int Slots);
+	int ReadGameStatus();
+
+	// The code cave and the display toggles. Added on attach, removed on detach.
+	Memory::PatchSet Patches;
+	int NODisplayCharPatch = -1;
+	int NODisplayShadowsPatch = -1;
+	int DisplaySuperShadowsPatch = -1;
+	void AddPatches();
+	// Brings the toggle patches in line with Toggles (bits), writes only what changed
+	void SyncPatches(int Toggles);
+
+	// Work the UI hands to the watcher, which does everything that talks to the game.
+	// Values are taken from Source, the character published the frame the edit was made.
+	struct QueuedEdit {
+		enum class Kind {
+			Colors,        // Count colors from First on
+			LineColor,
+			SuperShadow,   // super shadow First (0 or 1)
+			SwitchPallete, // First is 1 if the UI took the colors from the slot cache
+			CopyPallete,   // slot First into slot Pallete_Num
+			ReadSlots,     // every palette slot of ID into the slot cache
+			Toggles        // First holds the display toggles as bits
+		};
+		Kind What;
+		int ID;
+		int Pallete_Num;
+		int First;
+		int Count;
+		std::shared_ptr<const Character> Source;
+	};
+	// The edits of one UI frame, for the roster the UI held then
+	struct EditFrame {
+		uint64_t RosterGeneration;
+		uint64_t SlotVersions[6];
+		// LastUpdateReport counts this frame
+		bool bReport;
+		bool bVerify;
+		std::vector<QueuedEdit> Edits;
+	};
+	// UI side: color edits waiting for the end of frame, per character ID
+	struct PendingColors {
+		int Pallete_Num;
+		std::vector<bool> Dirty;
+	};
+	std::unordered_map<int, PendingColors> Pending;
+	// UI side: the other edits of this frame, in order
+	std::vector<QueuedEdit> FrameEdits;
+	bool bReportFrame = false;
+	void MarkColorDirty(const Character& Ch, int Color_ID);
+	void Queue(QueuedEdit::Kind What, int ID, int Pallete_Num, int First = 0, int Count = 0);
+	void QueueToggles();
+	// Puts an edit into LocalSlots as well
+	void KeepLocally(const QueuedEdit& Edit);
+	// Frames FlushWrites handed over, taken by the watcher
+	std::mutex OutboxLock;
+	std::vector<EditFrame> Outbox;
+	std::atomic<uint64_t> FramesQueued = 0;
+	std::atomic<uint64_t> FramesApplied = 0;
+	// Watcher side: applies every frame handed over as one edit
+	void ApplyEdits();
+	void ApplyColors(int ID, int Pallete_Num, int First, const __int32* Values, size_t Count);
+	void ApplyValue(int ID, int Pallete_Num, __int32 Character::* Field, __int32 Value);
+	void ApplySwitch(int ID, int Pallete_Num, bool bLoaded);
+	void ApplyCopy(int ID, int From_Num, int To_Num);
+	std::atomic<int> WritesFlushed = 0;
+	std::atomic<int> ColorsFlushed = 0;
+	// bVerifyWrites as of the frame being applied
+	bool bVerifying = true;
+
+	// Last palette state we read from or wrote to the game, per character ID
+	std::unordered_map<int, Character> Shadows;
+	size_t BytesWritten = 0;
+	size_t BytesSkipped = 0;
+	Character* FindShadow(int ID, int Pallete_Num);
+	// First-level pointers as of the last roster read. The game reallocates character
+	// and palette buffers on rematch or character swap, a changed pointer means the
+	// cached chains under it are stale.
+	struct SlotGeneration {
+		uintptr_t CharacterPointer;
+		uintptr_t PaletteDataPointer;
+	};
+	uintptr_t RootGeneration = 0;
+	SlotGeneration SlotGenerations[6] = {};
+	// Mirrored ranges of every slot (address to size), kept when other slots are read
+	// anew. Values of a palette are kept for the slot's current palette only, the
+	// mirror drops the others before its next refresh.
+	std::map<uintptr_t, size_t> SlotRanges[6];
+	std::map<uintptr_t, size_t> PalleteRanges[6];
+	int TrackedPallete[6] = { -1, -1, -1, -1, -1, -1 };
+	bool bRetrack = false;
+	void TrackSlot(int Slot, uintptr_t Address, size_t Size);
+	void TrackPallete(int Slot, int Pallete_Num, uintptr_t Address, size_t Size);
+	void ForgetTracked(int Slot);
+	// Mirrors the roster's ranges and nothing else, the pages fill on the next refresh
+	void RetrackMirror();
+	int ForgetMovedSlots();
+	void ReadRoster(int Slots);
+	void ReadPalletes(Character* Chars, size_t Count);
+
+	Memory::ChainCache Cache;
+	// Pages holding the palette tables of the match, refreshed once per poll
+	Memory::PageMirror Mirror;
+	// Remote writes of the watcher thread (the only producer), sent from a thread of their own.
+	// One per session: the ring has a single consumer.
+	Memory::RemoteWriter WriteQueue;
+	// Queues count values for the end of the chain and applies them to the mirror too.
+	// False only if the chain does not resolve, a write that fails later is caught by VerifyWrites.
+	template<typename T, size_t N>
+	bool WriteMirrored(int ID, const Memory::Chain<N>& Chain, const T* Values, size_t Count = 1) {
+		uintptr_t Address;
+		if (!Cache.Resolve(SG_Process, BaseAddress, Chain, &Address)) {
+			return false;
+		}
+		WriteQueue.Write(SG_Process, Address, Values, sizeof(T) * Count);
+		Mirror.Patch(Address, Values, sizeof(T) * Count);
+		RememberToVerify(ID, Address, Values, sizeof(T) * Count);
+		return true;
+	}
+
+	// Ranges written and not checked yet. The watcher checks a range once the writer
+	// sent it: from the mirror if that was refreshed since, with one scatter read of
+	// the rest otherwise, comparing hashes. A range the game overwrote is sent once more.
+	// A later write over part of a range updates its bytes, the game ends up with those.
+	struct WrittenSpan {
+		int ID;
+		uintptr_t Address;
+		size_t Size;
+		std::vector<char> Bytes;
+		uint64_t Hash;
+		// Queued() once the last write into the range was queued
+		uint64_t Write;
+		bool bResent;
+	};
+	std::vector<WrittenSpan> WrittenSpans;
+	void RememberToVerify(int ID, uintptr_t Address, const void* Data, size_t Size);
+	void ForgetWritten(int ID);
+	void VerifyWrites();
+
+	// Watcher side: palette slots as the game holds them, like Shadows
+	std::unordered_map<int, PalleteSlots> SlotCache;
+	void ReadAllPalletes(const Character& Ch);
+	// Takes the values of Ch.Current_Pallete_Num from the slot cache
+	bool LoadSlot(Character& Ch);
+	void StoreSlot(const Character& Ch);
 
 public:
-	static int FindVectorIndexByID(int id);
-	inline static int current_character_idx = -1;
-	inline static std::vector<Character> Character_Vector;
+	struct WriteReport {
+		size_t BytesWritten;
+		size_t BytesSkipped;
+	};
+	struct VerifyReport {
+		int Spans;
+		size_t BytesReadBack;
+		int Mismatches;
+	};
+
+	int FindVectorIndexByID(int id);
+	int current_character_idx = -1;
+	std::vector<Character> Character_Vector;
 	//Flags
-	inline static bool bGameOpenned = false;
-	inline static bool bMatchStarted = false;
+	bool bGameOpenned = false;
+	bool bMatchStarted = false;
 	//Flags of funny stuff
-	inline static bool bNODisplayChar = false;
-	inline static bool bNODisplayShadows = false;
-	inline static bool bDisplaySuperShadows = false;
-
-	static void ChangePallete();
-	static void ChangeColor(int Color_ID, __int32 colorValue);
-	static void ChangeAllColors();
-	static void ChangeLineColor();
-	static void ChangeSuperShadow1();
-	static void ChangeSuperShadow2();
-	static void Init();
-	static void Read_Character();
-	static void UpdateAllCharacters();
+	bool bNODisplayChar = false;
+	bool bNODisplayShadows = false;
+	bool bDisplaySuperShadows = false;
+	// Read written ranges back and send them again if the game overwrote them. UI side.
+	inline static bool bVerifyWrites = true;
+
+	// Every edit below is queued and goes to the game from the watcher thread, the
+	// UI never waits for the game
+	void ChangePallete();
+	// Slot operations of the selected character, Pallete_Num counts from 0.
+	// False if there is nothing to copy.
+	bool CopyPallete(int From_Num, int To_Num);
+	int ComparePalletes(int First_Num, int Second_Num);
+	void ChangeColor(int Color_ID, __int32 colorValue);
+	void ChangeAllColors();
+	// Hands the edits of this frame to the watcher
+	void FlushWrites();
+	int WritesLastFlush() const { return WritesFlushed; }
+	int ColorsLastFlush() const { return ColorsFlushed; }
+	const Memory::RemoteWriter& Writer() const { return WriteQueue; }
+	void ChangeLineColor();
+	void ChangeSuperShadow1();
+	void ChangeSuperShadow2();
+	// Once per frame on the UI thread: starts the watchers, drops the sessions of
+	// closed games and brings every session up to date with its latest snapshot
+	static void Update();
+	// End of frame on the UI thread: sends the edits of every session
+	static void FlushAll();
+	static void StopWatching();
+	// Loads the .tbl at Path, every attached session attaches again with it
+	static void LoadTable(const char* Path);
+	// The session the UI edits. A session without a game while none runs.
+	static PalEdit& Active();
+	static void Select(const std::shared_ptr<PalEdit>& Session);
+	static std::vector<std::shared_ptr<PalEdit>> Sessions();
+	std::shared_ptr<const GameSnapshot> Snapshot();
+	// Any thread: Model().Current() is the roster as of the last frame, edits
+	// published through it reach Character_Vector and the game the next frame
+	PaletteModel& Model() { return Palettes; }
+	// What polling this game costs, measured by its watcher thread
+	PollScheduler::Load Polling();
+	// How often the watchers look for games, backs off while none is found
+	static int DiscoveryIntervalMs() { return s_DiscoveryIntervalMs; }
+	// Has the watcher read every palette slot of the selected character
+	void Read_Character();
+	void UpdateAllCharacters();
+	// Writes these characters, the selection stays
+	void UpdateCharacters(const std::vector<int>& IDs);
+	WriteReport LastUpdateReport();
+	Divergence LastDivergence() const { return Diverged; }
+	VerifyReport LastVerify();
 	//Funny stuff
-	static void NODisplayChar();
-	static void NODisplayShadow();
-	static void DisplaySuperShadow();
+	void NODisplayChar();
+	void NODisplayShadow();
+	void DisplaySuperShadow();
+
+private:
+	// Written by the watcher, under SnapshotLock
+	WriteReport UpdateReport = { 0, 0 };
+	VerifyReport Verified = { 0, 0, 0 };
+
+	// Character_Vector is taken as the truth once a write went out, edits do not
+	// read the palette back. The watcher reads the roster's palettes every now
+	// and then, Update compares them with Character_Vector.
+	Divergence Diverged = { 0, 0 };
+	std::chrono::steady_clock::time_point LastReconcile;
+	void Reconcile(const GameSnapshot& Snapshot);
 };
 
 
@@ -0,0 +1,41 @@
+#include "pch.h"
+#include "PollScheduler.h"
+
+#define LOAD_WINDOW std::chrono::seconds(1)
+
+PollScheduler::PollScheduler(Clock::duration Fastest, Clock::duration Slowest)
+    : Fastest(Fastest), Slowest(Slowest), Interval(Fastest), Next(), WindowStart(Clock::now()) {
+}
+
+void PollScheduler::SetBounds(Clock::duration Fastest, Clock::duration Slowest) {
+    this->Fastest = Fastest;
+    this->Slowest = Slowest;
+    Interval = Fastest;
+    Next = Clock::now() + Fastest;
+}
+
+bool PollScheduler::Polled(Clock::time_point Now, bool bChanged, const Memory::ReadCost& Cost) {
+    // A change is likely followed by more (loading screens, character select),
+    // a quiet game by more quiet
+    Interval = bChanged ? Fastest : (std::min)(Slowest, Interval + Interval / 2);
+    Next = Now + Interval;
+
+    WindowPolls++;
+    WindowCost.Calls += Cost.Calls;
+    WindowCost.Bytes += Cost.Bytes;
+    auto Elapsed = Now - WindowStart;
+    if (Elapsed < LOAD_WINDOW) {
+        return false;
+    }
+    double Seconds = std::chrono::duration<double>(Elapsed).count();
+    Measured = {
+        static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(Interval).count()),
+        WindowPolls / Seconds,
+        WindowCost.Calls / Seconds,
+        WindowCost.Bytes / Seconds
+    };
+    WindowStart = Now;
+    WindowPolls = 0;
+    WindowCost = { 0, 0 };
+    return true;
+}
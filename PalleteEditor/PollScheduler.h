@@ -0,0 +1,42 @@
+#pragma once
+#include "pch.h"
+#include "Memory.h"
+#include <chrono>
+
+// When to poll the game next. Right after something changed it polls every
+// Fastest, every poll that finds nothing new stretches the interval by half,
+// up to Slowest. Also measures what the polling costs, per second.
+class PollScheduler {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// Polls per second and what they read, over the last full second
+	struct Load {
+		int IntervalMs;
+		double PollsPerSecond;
+		double ReadsPerSecond;
+		double BytesPerSecond;
+	};
+
+	PollScheduler(Clock::duration Fastest, Clock::duration Slowest);
+
+	// Other bounds for another state of the game, the next poll is due after Fastest
+	void SetBounds(Clock::duration Fastest, Clock::duration Slowest);
+	bool Due(Clock::time_point Now) const { return Now >= Next; }
+	Clock::time_point NextPoll() const { return Next; }
+	// Call after every poll with what it read. True when a second is over and
+	// LastLoad() has new figures.
+	bool Polled(Clock::time_point Now, bool bChanged, const Memory::ReadCost& Cost);
+	Load LastLoad() const { return Measured; }
+
+private:
+	Clock::duration Fastest;
+	Clock::duration Slowest;
+	Clock::duration Interval;
+	Clock::time_point Next;
+
+	Clock::time_point WindowStart;
+	int WindowPolls = 0;
+	Memory::ReadCost WindowCost = { 0, 0 };
+	Load Measured = { 0, 0, 0, 0 };
+};
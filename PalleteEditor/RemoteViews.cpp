@@ -0,0 +1,89 @@
+#include "pch.h"
+#include "RemoteViews.h"
+#include "Data/TableReader.h"
+#include <climits>
+
+// Longest name we expect when nothing follows it in the character struct
+#define MAX_INLINE_NAME 64
+
+RemoteView::RemoteView(uintptr_t address, std::initializer_list<Field> fields) : Address(address) {
+    int End = INT_MIN;
+    Begin = INT_MAX;
+    for (const Field& field : fields) {
+        Begin = (std::min)(Begin, field.Offset);
+        End = (std::max)(End, field.Offset + static_cast<int>(field.Size));
+    }
+    Bytes.resize(End - Begin);
+}
+
+Memory::Span RemoteView::Span() {
+    return { Address + Begin, Bytes.data(), Bytes.size() };
+}
+
+// The name runs up to the next field we know of
+static size_t InlineNameSize() {
+    int Next = INT_MAX;
+    for (int Offset : { AddressTable::Offset_PaletteData(), AddressTable::Offset_CurrentPalette() }) {
+        if (Offset > AddressTable::Offset_Name()) {
+            Next = (std::min)(Next, Offset);
+        }
+    }
+    return Next == INT_MAX ? MAX_INLINE_NAME : Next - AddressTable::Offset_Name();
+}
+
+CharacterView::CharacterView(uintptr_t address) : RemoteView(address, {
+    { AddressTable::Offset_Name(), InlineNameSize() },
+    { AddressTable::Offset_PaletteData(), sizeof(Memory::RemotePointer) },
+    { AddressTable::Offset_CurrentPalette(), sizeof(int) } }),
+    NameSize(InlineNameSize()) {
+}
+
+bool CharacterView::Name(std::string* result) const {
+    const char* Name = Bytes.data() + (AddressTable::Offset_Name() - Begin);
+    const char* Terminator = static_cast<const char*>(memchr(Name, '\0', NameSize));
+    if (Terminator == nullptr) {
+        return false;
+    }
+    result->assign(Name, Terminator);
+    return true;
+}
+
+uintptr_t CharacterView::NameAddress() const {
+    return Address + AddressTable::Offset_Name();
+}
+
+int CharacterView::CurrentPalette() const {
+    return Get<int>(AddressTable::Offset_CurrentPalette());
+}
+
+uintptr_t CharacterView::PaletteData() const {
+    return GetPointer(AddressTable::Offset_PaletteData());
+}
+
+PaletteDataView::PaletteDataView(uintptr_t address) : RemoteView(address, {
+    { AddressTable::Offset_PaletteTotalOffset(), sizeof(int) },
+    { AddressTable::Offset_NumberOfColor(), sizeof(int) },
+    { AddressTable::Offset_ColorCodeOffset(), sizeof(Memory::RemotePointer) },
+    { AddressTable::NEW_Offset_SuperShadow(), sizeof(Memory::RemotePointer) },
+    { AddressTable::NEW_Offset_LineColor(), sizeof(Memory::RemotePointer) } }) {
+}
+
+int PaletteDataView::Total() const {
+    return Get<int>(AddressTable::Offset_PaletteTotalOffset());
+}
+
+int PaletteDataView::NumberOfColors() const {
+    return Get<int>(AddressTable::Offset_NumberOfColor());
+}
+
+uintptr_t PaletteDataView::ColorPointers() const {
+    return GetPointer(AddressTable::Offset_ColorCodeOffset());
+}
+
+uintptr_t PaletteDataView::SuperShadowPointers() const {
+    return GetPointer(AddressTable::NEW_Offset_SuperShadow());
+}
+
+uintptr_t PaletteDataView::LineColors() const {
+    return GetPointer(AddressTable::NEW_Offset_LineColor());
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "pch.h"
+#include "Memory.h"
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// Local copy of a remote game struct. The fields are placed from AddressTable
+// offsets, the block spanning all of them is fetched with one read (Span) and
+// decoded here instead of reading field by field.
+class RemoteView {
+public:
+	uintptr_t Address = 0;
+
+	// Fills the whole block from the struct at Address
+	Memory::Span Span();
+	size_t Size() const { return Bytes.size(); }
+
+protected:
+	struct Field {
+		int Offset;
+		size_t Size;
+	};
+	RemoteView(uintptr_t address, std::initializer_list<Field> fields);
+
+	template<typename T>
+	T Get(int Offset) const {
+		T value;
+		memcpy(&value, Bytes.data() + (Offset - Begin), sizeof(T));
+		return value;
+	}
+	uintptr_t GetPointer(int Offset) const { return Get<Memory::RemotePointer>(Offset); }
+
+	int Begin = 0;
+	std::vector<char> Bytes;
+};
+
+// Character struct, one per slot
+class CharacterView : public RemoteView {
+public:
+	explicit CharacterView(uintptr_t address = 0);
+
+	// The name is stored inside the struct. False if it does not end within
+	// the bytes we fetched, read it with ChainCache::ReadString then.
+	bool Name(std::string* result) const;
+	uintptr_t NameAddress() const;
+	int CurrentPalette() const;
+	uintptr_t PaletteData() const;
+
+private:
+	size_t NameSize = 0;
+};
+
+// Palette data struct of a character
+class PaletteDataView : public RemoteView {
+public:
+	explicit PaletteDataView(uintptr_t address = 0);
+
+	int Total() const;
+	int NumberOfColors() const;
+	// Arrays indexed by palette number
+	uintptr_t ColorPointers() const;
+	uintptr_t SuperShadowPointers() const;
+	uintptr_t LineColors() const;
+};
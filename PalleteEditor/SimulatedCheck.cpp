@@ -0,0 +1,120 @@
+#include "pch.h"
+#include "PalleteEditor.h"
+#include "SimulatedGame.h"
+#include <thread>
+#include <functional>
+
+// Headless check of a whole editing session: the UI side of PalEdit is driven the
+// way Drawing does it, a frame at a time, against the in-process stand-in game,
+// and what ends up in the game is compared with what was edited.
+//
+//     SimulatedCheck <file.pal>
+//
+// Exits with 0 if every check passed.
+
+#define FRAME std::chrono::milliseconds(16)
+#define CHECK_TIMEOUT std::chrono::seconds(5)
+
+static int s_Failed = 0;
+
+// One UI frame: pick up the watcher's snapshots, then hand over the edits
+static void RunFrame() {
+    PalEdit::Update();
+    PalEdit::FlushAll();
+    std::this_thread::sleep_for(FRAME);
+}
+
+// Runs frames until Done holds, the check fails after CHECK_TIMEOUT
+static void Expect(const char* What, const std::function<bool()>& Done) {
+    auto Deadline = std::chrono::steady_clock::now() + CHECK_TIMEOUT;
+    while (!Done()) {
+        if (std::chrono::steady_clock::now() > Deadline) {
+            std::cout << "FAIL " << What << std::endl;
+            s_Failed++;
+            return;
+        }
+        RunFrame();
+    }
+    std::cout << "ok   " << What << std::endl;
+}
+
+static Character* Find(PalEdit& Session, int ID) {
+    int VectorID = Session.FindVectorIndexByID(ID);
+    return VectorID == -1 ? nullptr : &Session.Character_Vector[VectorID];
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: SimulatedCheck <file.pal>" << std::endl;
+        return 2;
+    }
+    SimulatedGame Game;
+    if (!Game.LoadCharacter(0, argv[1], 8) || !Game.LoadCharacter(3, argv[1], 8)) {
+        return 2;
+    }
+    Game.SetMatchStarted(true);
+    Memory::SetBackend(&Game);
+
+    Expect("the session attaches and reads the roster", [] {
+        PalEdit& Session = PalEdit::Active();
+        return Session.bMatchStarted && Find(Session, 0) && Find(Session, 3);
+    });
+    PalEdit& Session = PalEdit::Active();
+    if (!Find(Session, 0) || !Find(Session, 3)) {
+        PalEdit::StopWatching();
+        return 1;
+    }
+    Session.current_character_idx = 0;
+    Session.Read_Character();
+
+    const __int32 Edited = 0x0A0B0C0D;
+    Session.ChangeColor(3, Edited);
+    Expect("a color edit reaches the game", [&] {
+        __int32 Value = 0;
+        return Game.GetColor(0, 0, 3, &Value) && Value == Edited;
+    });
+
+    Find(Session, 0)->LineColor = 0x01020304;
+    Session.ChangeLineColor();
+    Expect("a line color edit reaches the game", [&] {
+        __int32 Value = 0;
+        return Game.GetLineColor(0, 0, &Value) && Value == 0x01020304;
+    });
+
+    __int32 Original = 0;
+    Game.GetColor(0, 2, 3, &Original);
+    Find(Session, 0)->Current_Pallete_Num = 2;
+    Session.ChangePallete();
+    Expect("a palette switch reaches the game and shows that palette", [&] {
+        return Game.CurrentPalette(0) == 2 && Find(Session, 0)->Character_Colors[3] == Original;
+    });
+
+    Session.CopyPallete(0, 2);
+    Expect("a slot copy reaches the game and the palette on screen", [&] {
+        __int32 Value = 0;
+        return Game.GetColor(0, 2, 3, &Value) && Value == Edited && Find(Session, 0)->Character_Colors[3] == Edited;
+    });
+    Expect("copied slots compare equal", [&] {
+        return Session.ComparePalletes(0, 2) == 0;
+    });
+
+    Game.SetColor(3, 5, 3, 0x05060708);
+    Game.SetCurrentPalette(3, 5);
+    Expect("a palette the game switched to is taken over", [&] {
+        Character* Ch = Find(Session, 3);
+        return Ch && Ch->Current_Pallete_Num == 5 && Ch->Character_Colors[3] == 0x05060708;
+    });
+
+    Expect("the game holds what the editor shows", [&] {
+        return Session.LastDivergence().Values == 0 && Session.LastVerify().Mismatches == 0;
+    });
+
+    Game.SetRunning(false);
+    Expect("a closed game ends its session", [] {
+        return PalEdit::Sessions().empty();
+    });
+
+    PalEdit::StopWatching();
+    std::cout << (s_Failed == 0 ? "all checks passed" : "some checks failed") << std::endl;
+    return s_Failed == 0 ? 0 : 1;
+}
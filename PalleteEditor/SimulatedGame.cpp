@@ -0,0 +1,337 @@
+#include "pch.h"
+#include "SimulatedGame.h"
+#include "Data/TableReader.h"
+
+#define GAME_STATUS_MATCH_STARTED 0x4
+#define CHARACTER_SLOT_COUNT 6
+// Covers the code PalEdit patches (the code cave at +0x332EC0 is the farthest)
+#define MODULE_SIZE 0x400000
+#define HEAP_BASE 0x10000000
+#define PAL_NAME_LENGTH 16
+#define FRAME_PERIOD std::chrono::microseconds(16667)
+
+SimulatedGame::SimulatedGame(DWORD ProcessId) : ProcessId(ProcessId), NextBlock(HEAP_BASE) {
+    size_t ModuleSize = MODULE_SIZE;
+    for (int Offset : { AddressTable::Base_Adress() + 4,
+        AddressTable::NEW_Base_Adress_DonotdisplayCHAR() + 2,
+        AddressTable::NEW_Base_Adress_DonotdisplaySHADOWS() + 2,
+        AddressTable::NEW_Base_Adress_Display_SuperShadowforever() + 6,
+        AddressTable::NEW_Base_Adress_FrameCounter() + 4 }) {
+        ModuleSize = (std::max)(ModuleSize, static_cast<size_t>(Offset));
+    }
+    // Mapped in whole pages, like the heap below
+    Blocks[MODULE_BASE].resize((ModuleSize + Memory::PageMirror::PAGE_SIZE - 1) & ~(Memory::PageMirror::PAGE_SIZE - 1));
+    // The code the display toggles replace, as the build AddressTable describes holds it
+    const unsigned char DisplayCharCode[] = { 0x77, 0x23 };
+    const unsigned char DisplayShadowsCode[] = { 0x75, 0x1E };
+    const unsigned char SuperShadowCode[] = { 0x0F, 0x8B, 0x22, 0x01, 0x00, 0x00 };
+    memcpy(Find(MODULE_BASE + AddressTable::NEW_Base_Adress_DonotdisplayCHAR(), sizeof(DisplayCharCode)), DisplayCharCode, sizeof(DisplayCharCode));
+    memcpy(Find(MODULE_BASE + AddressTable::NEW_Base_Adress_DonotdisplaySHADOWS(), sizeof(DisplayShadowsCode)), DisplayShadowsCode, sizeof(DisplayShadowsCode));
+    memcpy(Find(MODULE_BASE + AddressTable::NEW_Base_Adress_Display_SuperShadowforever(), sizeof(SuperShadowCode)), SuperShadowCode, sizeof(SuperShadowCode));
+
+    size_t RootSize = (std::max)(AddressTable::Offset_GameStatus() + sizeof(int),
+        AddressTable::Offset_Character() + CHARACTER_SLOT_COUNT * sizeof(Memory::RemotePointer));
+    Root = Allocate(RootSize);
+    Put(MODULE_BASE + AddressTable::Base_Adress(), static_cast<Memory::RemotePointer>(Root));
+    // Where the table said when the game was made, the frame thread never reads the table
+    if (AddressTable::NEW_Base_Adress_FrameCounter() != 0) {
+        FrameCounter = MODULE_BASE + AddressTable::NEW_Base_Adress_FrameCounter();
+    }
+    Frames = std::thread(&SimulatedGame::CountFrames, this);
+}
+
+SimulatedGame::~SimulatedGame() {
+    bCounting = false;
+    Frames.join();
+}
+
+void SimulatedGame::CountFrames() {
+    auto Next = std::chrono::steady_clock::now();
+    while (bCounting) {
+        Next += FRAME_PERIOD;
+        std::this_thread::sleep_until(Next);
+        if (!bPaused) {
+            NextFrame();
+        }
+    }
+}
+
+uintptr_t SimulatedGame::Allocate(size_t size) {
+    uintptr_t Address = NextBlock;
+    NextBlock = (Address + size + 0xF) & ~static_cast<uintptr_t>(0xF);
+    // The heap is mapped in whole pages, like the game's memory
+    size_t HeapSize = (NextBlock - HEAP_BASE + Memory::PageMirror::PAGE_SIZE - 1) & ~(Memory::PageMirror::PAGE_SIZE - 1);
+    Blocks[HEAP_BASE].resize(HeapSize);
+    return Address;
+}
+
+char* SimulatedGame::Find(uintptr_t address, size_t size) {
+    auto it = Blocks.upper_bound(address);
+    if (it == Blocks.begin()) {
+        return nullptr;
+    }
+    --it;
+    std::vector<char>& Bytes = it->second;
+    if (address + size > it->first + Bytes.size()) {
+        return nullptr;
+    }
+    return Bytes.data() + (address - it->first);
+}
+
+bool SimulatedGame::LoadCharacter(int Slot, const std::string& PalPath, int Pallete_Count) {
+    if (Slot < 0 || Slot >= CHARACTER_SLOT_COUNT || Pallete_Count <= 0) {
+        return false;
+    }
+    // Same layout PalleteFile reads: name, color count, hue shift, colors from
+    // the second one on, line color and both super shadows
+    std::ifstream file(PalPath, std::ios::binary);
+    char Name[PAL_NAME_LENGTH] = { 0 };
+    uint32_t NumOfColors = 0;
+    uint8_t HueShift[2] = {};
+    file.read(Name, sizeof(Name));
+    file.read(reinterpret_cast<char*>(&NumOfColors), sizeof(NumOfColors));
+    file.read(reinterpret_cast<char*>(HueShift), sizeof(HueShift));
+    if (!file || NumOfColors == 0) {
+        std::cerr << "Can't load simulated character from " << PalPath << std::endl;
+        return false;
+    }
+    std::vector<__int32> Colors(NumOfColors, 0);
+    file.read(reinterpret_cast<char*>(Colors.data() + 1), (NumOfColors - 1) * sizeof(__int32));
+    __int32 Extra[3] = {}; // line color, super shadow 1 and 2
+    file.read(reinterpret_cast<char*>(Extra), sizeof(Extra));
+    if (!file) {
+        std::cerr << "Can't load simulated character from " << PalPath << std::endl;
+        return false;
+    }
+    Name[PAL_NAME_LENGTH - 1] = '\0';
+
+    std::lock_guard<std::mutex> Guard(Lock);
+    size_t CharacterSize = (std::max)({ AddressTable::Offset_Name() + sizeof(Name),
+        AddressTable::Offset_PaletteData() + sizeof(Memory::RemotePointer),
+        AddressTable::Offset_CurrentPalette() + sizeof(int) });
+    uintptr_t Ch = Allocate(CharacterSize);
+    memcpy(Find(Ch + AddressTable::Offset_Name(), sizeof(Name)), Name, sizeof(Name));
+    Put(Ch + AddressTable::Offset_CurrentPalette(), 0);
+
+    size_t DataSize = 0;
+    for (int Offset : { AddressTable::Offset_PaletteTotalOffset(), AddressTable::Offset_NumberOfColor(),
+        AddressTable::Offset_ColorCodeOffset(), AddressTable::NEW_Offset_SuperShadow(),
+        AddressTable::NEW_Offset_LineColor() }) {
+        DataSize = (std::max)(DataSize, Offset + sizeof(Memory::RemotePointer));
+    }
+    uintptr_t Data = Allocate(DataSize);
+    Put(Ch + AddressTable::Offset_PaletteData(), static_cast<Memory::RemotePointer>(Data));
+    Put(Data + AddressTable::Offset_PaletteTotalOffset(), Pallete_Count);
+    Put(Data + AddressTable::Offset_NumberOfColor(), static_cast<int>(NumOfColors));
+
+    // Colors and super shadows through per-palette tables of pointers, each palette
+    // in buffers of its own. Line colors are one value per palette, in a row.
+    size_t TableSize = Pallete_Count * sizeof(Memory::RemotePointer);
+    uintptr_t ColorTable = Allocate(TableSize);
+    uintptr_t SuperShadowTable = Allocate(TableSize);
+    uintptr_t LineColorTable = Allocate(Pallete_Count * sizeof(__int32));
+    Put(Data + AddressTable::Offset_ColorCodeOffset(), static_cast<Memory::RemotePointer>(ColorTable));
+    Put(Data + AddressTable::NEW_Offset_SuperShadow(), static_cast<Memory::RemotePointer>(SuperShadowTable));
+    Put(Data + AddressTable::NEW_Offset_LineColor(), static_cast<Memory::RemotePointer>(LineColorTable));
+    for (int Pal{ 0 }; Pal < Pallete_Count; Pal++) {
+        uintptr_t PalColors = Allocate(Colors.size() * sizeof(__int32));
+        memcpy(Find(PalColors, Colors.size() * sizeof(__int32)), Colors.data(), Colors.size() * sizeof(__int32));
+        uintptr_t SuperShadows = Allocate(2 * sizeof(__int32));
+        Put(SuperShadows, Extra[1]);
+        Put(SuperShadows + sizeof(__int32), Extra[2]);
+
+        Put(ColorTable + Pal * sizeof(Memory::RemotePointer), static_cast<Memory::RemotePointer>(PalColors));
+        Put(SuperShadowTable + Pal * sizeof(Memory::RemotePointer), static_cast<Memory::RemotePointer>(SuperShadows));
+        Put(LineColorTable + Pal * sizeof(__int32), Extra[0]);
+    }
+
+    Put(Root + AddressTable::Offset_Character() + Slot * sizeof(Memory::RemotePointer), static_cast<Memory::RemotePointer>(Ch));
+    return true;
+}
+
+void SimulatedGame::SetMatchStarted(bool bStarted) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    Put(Root + AddressTable::Offset_GameStatus(), bStarted ? GAME_STATUS_MATCH_STARTED : 0);
+}
+
+void SimulatedGame::NextFrame() {
+    if (FrameCounter == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> Guard(Lock);
+    // A closed game counts no frames
+    if (!bRunning) {
+        return;
+    }
+    Put(FrameCounter, Get<uint32_t>(FrameCounter) + 1);
+}
+
+void SimulatedGame::SetPaused(bool bPaused) {
+    this->bPaused = bPaused;
+}
+
+void SimulatedGame::SetRunning(bool bRunning) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    this->bRunning = bRunning;
+}
+
+uintptr_t SimulatedGame::CharacterOf(int Slot) {
+    if (Slot < 0 || Slot >= CHARACTER_SLOT_COUNT) {
+        return 0;
+    }
+    return Get<Memory::RemotePointer>(Root + AddressTable::Offset_Character() + Slot * sizeof(Memory::RemotePointer));
+}
+
+bool SimulatedGame::SetCurrentPalette(int Slot, int Pallete_Num) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    uintptr_t Ch = CharacterOf(Slot);
+    if (Ch == 0) {
+        return false;
+    }
+    Put(Ch + AddressTable::Offset_CurrentPalette(), Pallete_Num);
+    return true;
+}
+
+// Address of a color, 0 if there is no such slot, palette or color
+uintptr_t SimulatedGame::ColorOf(int Slot, int Pallete_Num, int Color_ID) {
+    uintptr_t Ch = CharacterOf(Slot);
+    if (Ch == 0) {
+        return 0;
+    }
+    uintptr_t Data = Get<Memory::RemotePointer>(Ch + AddressTable::Offset_PaletteData());
+    if (Pallete_Num < 0 || Pallete_Num >= Get<int>(Data + AddressTable::Offset_PaletteTotalOffset()) ||
+        Color_ID < 0 || Color_ID >= Get<int>(Data + AddressTable::Offset_NumberOfColor())) {
+        return 0;
+    }
+    uintptr_t ColorTable = Get<Memory::RemotePointer>(Data + AddressTable::Offset_ColorCodeOffset());
+    uintptr_t Colors = Get<Memory::RemotePointer>(ColorTable + Pallete_Num * sizeof(Memory::RemotePointer));
+    return Colors + Color_ID * sizeof(__int32);
+}
+
+bool SimulatedGame::SetColor(int Slot, int Pallete_Num, int Color_ID, __int32 Value) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    uintptr_t Color = ColorOf(Slot, Pallete_Num, Color_ID);
+    if (Color == 0) {
+        return false;
+    }
+    Put(Color, Value);
+    return true;
+}
+
+bool SimulatedGame::GetColor(int Slot, int Pallete_Num, int Color_ID, __int32* Value) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    uintptr_t Color = ColorOf(Slot, Pallete_Num, Color_ID);
+    if (Color == 0) {
+        return false;
+    }
+    *Value = Get<__int32>(Color);
+    return true;
+}
+
+bool SimulatedGame::GetLineColor(int Slot, int Pallete_Num, __int32* Value) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    // Color 0 is there in every palette
+    if (ColorOf(Slot, Pallete_Num, 0) == 0) {
+        return false;
+    }
+    uintptr_t Data = Get<Memory::RemotePointer>(CharacterOf(Slot) + AddressTable::Offset_PaletteData());
+    uintptr_t LineColors = Get<Memory::RemotePointer>(Data + AddressTable::NEW_Offset_LineColor());
+    *Value = Get<__int32>(LineColors + Pallete_Num * sizeof(__int32));
+    return true;
+}
+
+int SimulatedGame::CurrentPalette(int Slot) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    uintptr_t Ch = CharacterOf(Slot);
+    return Ch == 0 ? -1 : Get<int>(Ch + AddressTable::Offset_CurrentPalette());
+}
+
+SimulatedGame::Stats SimulatedGame::ReadStats() const {
+    std::lock_guard<std::mutex> Guard(Lock);
+    return Reads;
+}
+
+SimulatedGame::Stats SimulatedGame::WriteStats() const {
+    std::lock_guard<std::mutex> Guard(Lock);
+    return Writes;
+}
+
+void SimulatedGame::ResetStats() {
+    std::lock_guard<std::mutex> Guard(Lock);
+    Reads = { 0, 0, 0 };
+    Writes = { 0, 0, 0 };
+}
+
+std::vector<DWORD> SimulatedGame::FindProcessIds(const std::wstring&) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    if (!bRunning) {
+        return {};
+    }
+    return { ProcessId };
+}
+
+DWORD SimulatedGame::GetModuleBaseAddress(DWORD dwProcessId, const std::wstring&) {
+    return dwProcessId == ProcessId ? static_cast<DWORD>(MODULE_BASE) : 0;
+}
+
+Memory::ProcessHandle SimulatedGame::OpenProcessHandle(DWORD dwProcessId) {
+#ifdef _WIN32
+    return reinterpret_cast<HANDLE>(static_cast<uintptr_t>(dwProcessId));
+#else
+    return static_cast<pid_t>(dwProcessId);
+#endif
+}
+
+void SimulatedGame::CloseProcessHandle(Memory::ProcessHandle) {
+}
+
+bool SimulatedGame::IsProcessAlive(Memory::ProcessHandle) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    return bRunning;
+}
+
+bool SimulatedGame::Read(Memory::ProcessHandle, uintptr_t address, void* buffer, size_t size) {
+    Memory::Span span{ address, buffer, size };
+    return Transfer(&span, 1, false);
+}
+
+bool SimulatedGame::Write(Memory::ProcessHandle, uintptr_t address, const void* buffer, size_t size) {
+    Memory::Span span{ address, const_cast<void*>(buffer), size };
+    return Transfer(&span, 1, true);
+}
+
+bool SimulatedGame::ReadScatter(Memory::ProcessHandle, const Memory::Span* spans, size_t count) {
+    return Transfer(spans, count, false);
+}
+
+bool SimulatedGame::WriteScatter(Memory::ProcessHandle, const Memory::Span* spans, size_t count) {
+    return Transfer(spans, count, true);
+}
+
+// All or nothing per call, the way a failed process_vm_readv/writev reports it
+bool SimulatedGame::Transfer(const Memory::Span* spans, size_t count, bool bWrite) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    Stats& Counters = bWrite ? Writes : Reads;
+    Counters.Calls++;
+    Counters.Spans += count;
+    if (!bRunning) {
+        return false;
+    }
+    std::vector<char*> Targets(count);
+    for (size_t i = 0; i < count; ++i) {
+        Targets[i] = Find(spans[i].Address, spans[i].Size);
+        if (Targets[i] == nullptr) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (bWrite) {
+            memcpy(Targets[i], spans[i].Buffer, spans[i].Size);
+        }
+        else {
+            memcpy(spans[i].Buffer, Targets[i], spans[i].Size);
+        }
+        Counters.Bytes += spans[i].Size;
+    }
+    return true;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "pch.h"
+#include "Memory.h"
+#include <map>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+// In-process stand-in for a running Skullgirls. Its memory is laid out the way
+// AddressTable describes the game (root struct, six character slots, palette
+// data with per-palette tables) and filled from .pal files, so roster reads,
+// palette edits and auto-load run without the game after Memory::SetBackend.
+// A thread of its own counts frames at 60 per second while the game runs.
+class SimulatedGame : public Memory::Backend {
+public:
+	static constexpr DWORD PROCESS_ID = 0x5347;
+	static constexpr uintptr_t MODULE_BASE = 0x00400000;
+
+	// Transfer counters, to measure what a code path costs
+	struct Stats {
+		size_t Calls;
+		size_t Spans;
+		size_t Bytes;
+	};
+
+	// Several games run side by side under different process ids
+	explicit SimulatedGame(DWORD ProcessId = PROCESS_ID);
+	~SimulatedGame();
+
+	// Puts the character of a .pal file into Slot (0..5), every one of its
+	// Pallete_Count palettes holds the file's colors. A slot that is taken
+	// gets new buffers, like the game does on a character swap.
+	bool LoadCharacter(int Slot, const std::string& PalPath, int Pallete_Count);
+	void SetMatchStarted(bool bStarted);
+	// What a player picking another palette or the game reloading one looks like
+	bool SetCurrentPalette(int Slot, int Pallete_Num);
+	bool SetColor(int Slot, int Pallete_Num, int Color_ID, __int32 Value);
+	// What the game holds, to check what the editor wrote
+	bool GetColor(int Slot, int Pallete_Num, int Color_ID, __int32* Value);
+	bool GetLineColor(int Slot, int Pallete_Num, __int32* Value);
+	// -1 for an empty slot
+	int CurrentPalette(int Slot);
+	// Bumps the frame counter, if AddressTable had one when the game was made.
+	// The frame thread calls it.
+	void NextFrame();
+	// A paused or loading game stops counting frames
+	void SetPaused(bool bPaused);
+	// A closed game is not found by FindProcessIds and fails every transfer
+	void SetRunning(bool bRunning);
+
+	Stats ReadStats() const;
+	Stats WriteStats() const;
+	void ResetStats();
+
+	std::vector<DWORD> FindProcessIds(const std::wstring& targetProcessName) override;
+	DWORD GetModuleBaseAddress(DWORD dwProcessId, const std::wstring& ModuleName) override;
+	Memory::ProcessHandle OpenProcessHandle(DWORD dwProcessId) override;
+	void CloseProcessHandle(Memory::ProcessHandle hProcess) override;
+	bool IsProcessAlive(Memory::ProcessHandle hProcess) override;
+	bool Read(Memory::ProcessHandle hProcess, uintptr_t address, void* buffer, size_t size) override;
+	bool Write(Memory::ProcessHandle hProcess, uintptr_t address, const void* buffer, size_t size) override;
+	bool ReadScatter(Memory::ProcessHandle hProcess, const Memory::Span* spans, size_t count) override;
+	bool WriteScatter(Memory::ProcessHandle hProcess, const Memory::Span* spans, size_t count) override;
+
+private:
+	// Packs blocks one after another on the heap, reads past the heap fail
+	uintptr_t Allocate(size_t size);
+	char* Find(uintptr_t address, size_t size);
+	template<typename T>
+	void Put(uintptr_t address, const T& value) {
+		memcpy(Find(address, sizeof(T)), &value, sizeof(T));
+	}
+	template<typename T>
+	T Get(uintptr_t address) {
+		T value{};
+		if (const char* Bytes = Find(address, sizeof(T))) {
+			memcpy(&value, Bytes, sizeof(T));
+		}
+		return value;
+	}
+	// Character struct of a slot, 0 if the slot is empty
+	uintptr_t CharacterOf(int Slot);
+	uintptr_t ColorOf(int Slot, int Pallete_Num, int Color_ID);
+	bool Transfer(const Memory::Span* spans, size_t count, bool bWrite);
+	void CountFrames();
+
+	const DWORD ProcessId;
+	mutable std::mutex Lock;
+	std::map<uintptr_t, std::vector<char>> Blocks; // module and heap, by start address
+	uintptr_t NextBlock;
+	uintptr_t Root;
+	uintptr_t FrameCounter = 0;
+	bool bRunning = true;
+	Stats Reads = { 0, 0, 0 };
+	Stats Writes = { 0, 0, 0 };
+	std::atomic<bool> bPaused = false;
+	std::atomic<bool> bCounting = true;
+	std::thread Frames;
+};
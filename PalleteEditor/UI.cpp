@@ -1,6 +1,7 @@
 #include "UI.h"
 #include "Drawing.h"
 #include "StyleImGui.h"
+#include "PalleteEditor.h"
 
 ID3D11Device* UI::pd3dDevice = nullptr;
 ID3D11DeviceContext* UI::pd3dDeviceContext = nullptr;
@@ -224,6 +225,7 @@ void UI::Render()
         #endif
     }
 
+    PalEdit::StopWatching();
     ImGui_ImplDX11_Shutdown();
     ImGui_ImplWin32_Shutdown();
     ImGui::DestroyContext();
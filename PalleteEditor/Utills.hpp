@@ -3,7 +3,11 @@
 namespace Utills {
     std::wstring to_lower(const std::wstring& str) {
         std::wstring result = str;
+#ifdef _WIN32
         CharLowerW(&result[0]);
+#else
+        std::transform(result.begin(), result.end(), result.begin(), ::towlower);
+#endif
         return result;
     }
 }
\ No newline at end of file
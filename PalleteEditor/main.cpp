@@ -1,10 +1,30 @@
 #include <thread>
 #include "UI.h"
 #include "Config.h"
+#include "SimulatedGame.h"
 
 int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPWSTR lpCmdLine, _In_ int nShowCmd)
 {
     config::init();
+
+    // --simulate <file.pal>: edit an in-process game image instead of Skullgirls.exe
+    // Made only then, it runs a frame thread of its own
+    static std::unique_ptr<SimulatedGame> Simulated;
+    const std::wstring SimulateFlag = L"--simulate ";
+    std::wstring CmdLine = lpCmdLine;
+    if (CmdLine.rfind(SimulateFlag, 0) == 0) {
+        std::wstring PalPath = CmdLine.substr(SimulateFlag.size());
+        PalPath.erase(std::remove(PalPath.begin(), PalPath.end(), L'"'), PalPath.end());
+        Simulated = std::make_unique<SimulatedGame>();
+        if (Simulated->LoadCharacter(0, std::filesystem::path(PalPath).string(), 10)) {
+            Simulated->SetMatchStarted(true);
+            Memory::SetBackend(Simulated.get());
+        }
+        else {
+            Simulated.reset();
+        }
+    }
+
     UI::Render();
     return 0;
 }
@@ -1,6 +1,7 @@
 #ifndef PCH_H
 #define PCH_H
 
+#ifdef _WIN32
 //Win32
 #include <Windows.h>
 #include <tchar.h>
@@ -10,6 +11,16 @@
 #include "ImGui/imgui.h"
 #include "ImGui/imgui_impl_dx11.h"
 #include "ImGui/imgui_impl_win32.h"
+#else
+//Linux (game under Wine/Proton), only the Memory backend is native here
+#include <sys/types.h>
+#include <cstdint>
+#include <cwctype>
+#include <algorithm>
+#include "ImGui/imgui.h"
+typedef uint32_t DWORD;
+typedef int32_t __int32;
+#endif
 
 //Files
 #include <fstream>